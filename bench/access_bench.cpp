@@ -0,0 +1,50 @@
+// Checked access on the hot path, built twice: with exceptions and with
+// -fno-exceptions (CXXUTILS_NO_EXCEPTIONS), to compare the two modes.
+#include "cxxutils/optional.hpp"
+#include "cxxutils/result.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+
+std::vector<optional<int>> makeOptionals() {
+    std::vector<optional<int>> v;
+    for(int i = 0; i < 1024; ++i)
+        v.push_back(optional<int>(i));
+    return v;
+}
+
+std::vector<Result<int>> makeResults() {
+    std::vector<Result<int>> v;
+    for(int i = 0; i < 1024; ++i)
+        v.push_back(Result<int>::ok(i));
+    return v;
+}
+
+void BM_Optional_GetValue(benchmark::State & state) {
+    std::vector<optional<int>> in = makeOptionals();
+    for(auto _ : state) {
+        long total = 0;
+        for(const optional<int> & o : in)
+            total += o.getValue();
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * in.size());
+}
+BENCHMARK(BM_Optional_GetValue);
+
+void BM_Result_GetValueOrThrow(benchmark::State & state) {
+    std::vector<Result<int>> in = makeResults();
+    for(auto _ : state) {
+        long total = 0;
+        for(const Result<int> & r : in)
+            total += r.getValueOrThrow();
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * in.size());
+}
+BENCHMARK(BM_Result_GetValueOrThrow);
+
+}
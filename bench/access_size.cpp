@@ -0,0 +1,25 @@
+// Out-of-line users of the checked accessors, compiled with and without
+// exceptions; the cxxutils_size_report target compares the object sizes.
+#include "cxxutils/optional.hpp"
+#include "cxxutils/result.hpp"
+
+#include <string>
+
+int sumOptionals(const optional<int> * values, int n) {
+    int total = 0;
+    for(int i = 0; i < n; ++i)
+        total += values[i].getValue();
+    return total;
+}
+
+std::string takeName(optional<std::string> & name) {
+    return name.takeValue();
+}
+
+int valueOrThrow(const Result<int> & r) {
+    return r.getValueOrThrow();
+}
+
+std::size_t lengthOrThrow(const Result<std::string> & r) {
+    return r.getValueOrThrow().size();
+}
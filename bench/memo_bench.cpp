@@ -0,0 +1,64 @@
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_memo.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// Lookups of 1024 hot keys: recomputing every time, a mutex-guarded
+// unordered_map of Results, and the lock-free hits of MemoCache, each from
+// one and from four threads.
+
+namespace {
+
+Result<std::uint64_t> expensive(std::uint64_t x) {
+    for(int i = 0; i < 256; ++i)
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    if(x % 10 == 3)
+        return make_result_failed<std::uint64_t>("lookup", "not found");
+    return Result<std::uint64_t>::ok(x);
+}
+
+constexpr std::uint64_t keys = 1024;
+
+void BM_Recompute(benchmark::State & state) {
+    std::uint64_t key = static_cast<std::uint64_t>(state.thread_index());
+    for(auto _ : state) {
+        Result<std::uint64_t> r = expensive(key++ % keys);
+        benchmark::DoNotOptimize(r.isOK());
+    }
+}
+BENCHMARK(BM_Recompute)->Threads(1)->Threads(4);
+
+std::mutex mapMutex;
+std::unordered_map<std::uint64_t, Result<std::uint64_t>> map;
+
+void BM_MutexMap(benchmark::State & state) {
+    std::uint64_t key = static_cast<std::uint64_t>(state.thread_index());
+    for(auto _ : state) {
+        std::uint64_t k = key++ % keys;
+        std::unique_lock<std::mutex> lock(mapMutex);
+        auto it = map.find(k);
+        if(it == map.end())
+            it = map.emplace(k, expensive(k)).first;
+        Result<std::uint64_t> r = it->second;
+        lock.unlock();
+        benchmark::DoNotOptimize(r.isOK());
+    }
+}
+BENCHMARK(BM_MutexMap)->Threads(1)->Threads(4);
+
+cxxutils::MemoCache<std::uint64_t, std::uint64_t> cache;
+
+void BM_MemoCache(benchmark::State & state) {
+    std::uint64_t key = static_cast<std::uint64_t>(state.thread_index());
+    for(auto _ : state) {
+        Result<std::uint64_t> r = cache.get(key++ % keys, expensive);
+        benchmark::DoNotOptimize(r.isOK());
+    }
+}
+BENCHMARK(BM_MemoCache)->Threads(1)->Threads(4);
+
+}
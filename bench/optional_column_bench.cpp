@@ -0,0 +1,153 @@
+#include "cxxutils/optional.hpp"
+#include "cxxutils/optional_column.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <vector>
+
+// Nullable column kernels against the same loop over vector<optional<T>>.
+// The argument is the row count; every tenth row is missing. The fill-missing
+// benchmarks include restoring their input, which is a copy of each layout.
+
+namespace {
+
+template<typename T>
+std::vector<optional<T>> makeRows(std::size_t n) {
+    std::vector<optional<T>> rows;
+    rows.reserve(n);
+    for(std::size_t i = 0; i < n; ++i)
+        rows.push_back(i % 10 == 3 ? optional<T>() : optional<T>(static_cast<T>((i * 37) % 1000)));
+    return rows;
+}
+
+template<typename T>
+void setBytes(benchmark::State & state) {
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(sizeof(T)));
+}
+
+template<typename T>
+void BM_Rows_Sum(benchmark::State & state) {
+    std::vector<optional<T>> rows = makeRows<T>(state.range(0));
+    for(auto _ : state) {
+        T total = T();
+        for(const optional<T> & row : rows)
+            if(row.hasValue())
+                total += row.getValue();
+        benchmark::DoNotOptimize(total);
+    }
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Column_Sum(benchmark::State & state) {
+    cxxutils::OptionalColumn<T> column(makeRows<T>(state.range(0)));
+    for(auto _ : state)
+        benchmark::DoNotOptimize(column.sum());
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Rows_Max(benchmark::State & state) {
+    std::vector<optional<T>> rows = makeRows<T>(state.range(0));
+    for(auto _ : state) {
+        optional<T> best;
+        for(const optional<T> & row : rows)
+            if(row.hasValue() && (!best.hasValue() || best.getValue() < row.getValue()))
+                best = row;
+        benchmark::DoNotOptimize(best);
+    }
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Column_Max(benchmark::State & state) {
+    cxxutils::OptionalColumn<T> column(makeRows<T>(state.range(0)));
+    for(auto _ : state)
+        benchmark::DoNotOptimize(column.max());
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Rows_CountValid(benchmark::State & state) {
+    std::vector<optional<T>> rows = makeRows<T>(state.range(0));
+    for(auto _ : state) {
+        std::size_t n = 0;
+        for(const optional<T> & row : rows)
+            n += row.hasValue() ? 1 : 0;
+        benchmark::DoNotOptimize(n);
+    }
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Column_CountValid(benchmark::State & state) {
+    cxxutils::OptionalColumn<T> column(makeRows<T>(state.range(0)));
+    for(auto _ : state)
+        benchmark::DoNotOptimize(column.countValid());
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Rows_Filter(benchmark::State & state) {
+    std::vector<optional<T>> rows = makeRows<T>(state.range(0));
+    for(auto _ : state) {
+        std::vector<T> kept;
+        kept.reserve(rows.size());
+        for(const optional<T> & row : rows)
+            if(row.hasValue() && row.getValue() > T(500))
+                kept.push_back(row.getValue());
+        benchmark::DoNotOptimize(kept.data());
+    }
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Column_Filter(benchmark::State & state) {
+    cxxutils::OptionalColumn<T> column(makeRows<T>(state.range(0)));
+    for(auto _ : state) {
+        cxxutils::OptionalColumn<T> kept = column.filter([](T v) { return v > T(500); });
+        benchmark::DoNotOptimize(kept.values());
+    }
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Rows_FillMissing(benchmark::State & state) {
+    std::vector<optional<T>> source = makeRows<T>(state.range(0));
+    std::vector<optional<T>> rows = source;
+    for(auto _ : state) {
+        rows = source;
+        for(optional<T> & row : rows)
+            if(!row.hasValue())
+                row.emplace(T(0));
+        benchmark::DoNotOptimize(rows.data());
+    }
+    setBytes<T>(state);
+}
+
+template<typename T>
+void BM_Column_FillMissing(benchmark::State & state) {
+    cxxutils::OptionalColumn<T> source(makeRows<T>(state.range(0)));
+    cxxutils::OptionalColumn<T> column = source;
+    for(auto _ : state) {
+        column = source;
+        column.fillMissing(T(0));
+        benchmark::DoNotOptimize(column.values());
+    }
+    setBytes<T>(state);
+}
+
+}
+
+#define CXXUTILS_COLUMN_BENCH(name)                                 \
+    BENCHMARK_TEMPLATE(BM_Rows_##name, double)->Arg(1 << 16);       \
+    BENCHMARK_TEMPLATE(BM_Column_##name, double)->Arg(1 << 16);     \
+    BENCHMARK_TEMPLATE(BM_Rows_##name, std::int32_t)->Arg(1 << 16); \
+    BENCHMARK_TEMPLATE(BM_Column_##name, std::int32_t)->Arg(1 << 16)
+
+CXXUTILS_COLUMN_BENCH(Sum);
+CXXUTILS_COLUMN_BENCH(Max);
+CXXUTILS_COLUMN_BENCH(CountValid);
+CXXUTILS_COLUMN_BENCH(Filter);
+CXXUTILS_COLUMN_BENCH(FillMissing);
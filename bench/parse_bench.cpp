@@ -0,0 +1,161 @@
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_parse.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+// Line-oriented parsing: the copying approach (substrings into std::string,
+// then strtoll/strtod) against the zero-copy toolkit. Both turn each record
+// into Results and sum the fields so nothing is optimized away.
+
+namespace {
+std::atomic<std::size_t> g_allocations{0};
+}
+
+void* operator new(std::size_t n) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State & state) : state_(state), start_(g_allocations.load()) {}
+    ~AllocationCounter() {
+        state_.counters["allocs/iter"] = benchmark::Counter(
+            static_cast<double>(g_allocations.load() - start_), benchmark::Counter::kAvgIterations);
+    }
+private:
+    benchmark::State & state_;
+    std::size_t start_;
+};
+
+// id,price,quantity,symbol records, about 16MB in total.
+const std::string & input() {
+    static const std::string text = [] {
+        std::string s;
+        for(std::size_t i = 0; s.size() < (16u << 20); ++i) {
+            s += std::to_string(100000 + i * 7919 % 900000);
+            s += ',';
+            s += std::to_string(i % 1000);
+            s += '.';
+            s += std::to_string(10 + i % 90);
+            s += ',';
+            s += std::to_string(i % 250);
+            s += ",SYMBOL";
+            s += std::to_string(i % 17);
+            s += '\n';
+        }
+        return s;
+    }();
+    return text;
+}
+
+Result<long long> parseIntCopy(const std::string & field) {
+    errno = 0;
+    char* end = nullptr;
+    long long v = std::strtoll(field.c_str(), &end, 10);
+    if(field.empty() || *end != '\0' || errno == ERANGE)
+        return make_result_failed<long long>("parse", "invalid integer: " + field);
+    return Result<long long>::ok(v);
+}
+
+Result<double> parseDoubleCopy(const std::string & field) {
+    char* end = nullptr;
+    double v = std::strtod(field.c_str(), &end);
+    if(field.empty() || *end != '\0')
+        return make_result_failed<double>("parse", "invalid number: " + field);
+    return Result<double>::ok(v);
+}
+
+void BM_Parse_CopyingStrings(benchmark::State & state) {
+    const std::string & text = input();
+    AllocationCounter allocs(state);
+    for(auto _ : state) {
+        double total = 0;
+        std::size_t pos = 0;
+        while(pos < text.size()) {
+            std::size_t eol = text.find('\n', pos);
+            std::string line = text.substr(pos, eol - pos);
+            pos = eol + 1;
+            std::size_t a = line.find(',');
+            std::size_t b = line.find(',', a + 1);
+            std::size_t c = line.find(',', b + 1);
+            Result<long long> id = parseIntCopy(line.substr(0, a));
+            Result<double> price = parseDoubleCopy(line.substr(a + 1, b - a - 1));
+            Result<long long> qty = parseIntCopy(line.substr(b + 1, c - b - 1));
+            std::string symbol = line.substr(c + 1);
+            if(id.isOK() && price.isOK() && qty.isOK())
+                total += static_cast<double>(id.getValue()) + price.getValue() * static_cast<double>(qty.getValue()) + static_cast<double>(symbol.size());
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(text.size()));
+}
+BENCHMARK(BM_Parse_CopyingStrings)->Unit(benchmark::kMillisecond);
+
+void BM_Parse_ZeroCopy(benchmark::State & state) {
+    const std::string & text = input();
+    AllocationCounter allocs(state);
+    for(auto _ : state) {
+        double total = 0;
+        cxxutils::LineScanner lines(text);
+        for(optional<std::string_view> line = lines.next(); line.hasValue(); line = lines.next()) {
+            cxxutils::FieldSplitter fields(line.getValue(), ',', lines.offset());
+            Result<long long, cxxutils::ParseError> id = fields.nextAs<long long>();
+            Result<double, cxxutils::ParseError> price = fields.nextAs<double>();
+            Result<long long, cxxutils::ParseError> qty = fields.nextAs<long long>();
+            Result<std::string_view, cxxutils::ParseError> symbol = fields.next();
+            if(id.isOK() && price.isOK() && qty.isOK() && symbol.isOK())
+                total += static_cast<double>(id.getValue()) + price.getValue() * static_cast<double>(qty.getValue()) + static_cast<double>(symbol.getValue().size());
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(text.size()));
+}
+BENCHMARK(BM_Parse_ZeroCopy)->Unit(benchmark::kMillisecond);
+
+// Scanning alone: the ceiling the parsers work against.
+void BM_Scan_Lines(benchmark::State & state) {
+    const std::string & text = input();
+    for(auto _ : state) {
+        std::size_t n = 0;
+        cxxutils::LineScanner lines(text);
+        for(optional<std::string_view> line = lines.next(); line.hasValue(); line = lines.next())
+            n += line.getValue().size();
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(text.size()));
+}
+BENCHMARK(BM_Scan_Lines)->Unit(benchmark::kMillisecond);
+
+void BM_Scan_Memchr(benchmark::State & state) {
+    const std::string & text = input();
+    for(auto _ : state) {
+        std::size_t n = 0;
+        const char* p = text.data();
+        const char* end = p + text.size();
+        while(const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)))) {
+            n += static_cast<std::size_t>(nl - p);
+            p = nl + 1;
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(text.size()));
+}
+BENCHMARK(BM_Scan_Memchr)->Unit(benchmark::kMillisecond);
+
+}
@@ -0,0 +1,82 @@
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_pipeline.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Three Result stages over 64k records, one record in ten failing: the
+// hand-rolled flatmap loop against the pipeline, sequential and with a
+// thread per stage. The stages do a little arithmetic each so that the
+// concurrent pipeline has something to overlap.
+
+namespace {
+
+std::uint64_t mix(std::uint64_t x) {
+    for(int i = 0; i < 64; ++i)
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return x;
+}
+
+Result<std::uint64_t> decode(std::uint64_t x) {
+    if(x % 10 == 3)
+        return make_result_failed<std::uint64_t>("decode", "bad record");
+    return Result<std::uint64_t>::ok(mix(x));
+}
+
+Result<std::uint64_t> transform(std::uint64_t x) {
+    return Result<std::uint64_t>::ok(mix(x ^ 0x9e3779b97f4a7c15ull));
+}
+
+Result<std::uint64_t> checksum(std::uint64_t x) {
+    return Result<std::uint64_t>::ok(mix(x) >> 7);
+}
+
+const std::vector<std::uint64_t> & input() {
+    static const std::vector<std::uint64_t> in = [] {
+        std::vector<std::uint64_t> v(1 << 16);
+        for(std::size_t i = 0; i < v.size(); ++i)
+            v[i] = i;
+        return v;
+    }();
+    return in;
+}
+
+void BM_Pipeline_FlatmapLoop(benchmark::State & state) {
+    for(auto _ : state) {
+        std::uint64_t total = 0;
+        std::size_t failures = 0;
+        for(std::uint64_t x : input()) {
+            Result<std::uint64_t> r = decode(x).flatmap(transform).flatmap(checksum);
+            if(r.isOK())
+                total += r.getValue();
+            else
+                ++failures;
+        }
+        benchmark::DoNotOptimize(total);
+        benchmark::DoNotOptimize(failures);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(input().size()));
+}
+BENCHMARK(BM_Pipeline_FlatmapLoop)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_Pipeline_Run(benchmark::State & state) {
+    ResultUtils::PipelineOptions options;
+    options.concurrent = state.range(0) != 0;
+    auto pipeline = ResultUtils::Pipeline<std::uint64_t>(options)
+        .then("decode", decode)
+        .then("transform", transform)
+        .then("checksum", checksum);
+    for(auto _ : state) {
+        std::uint64_t total = 0;
+        ResultUtils::PipelineRun run = pipeline.run(input(), [&](std::uint64_t x) { total += x; });
+        benchmark::DoNotOptimize(total);
+        benchmark::DoNotOptimize(run.failures.size());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(input().size()));
+}
+BENCHMARK(BM_Pipeline_Run)->ArgName("concurrent")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
@@ -0,0 +1,115 @@
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_validated.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+// Four independent checks on a record: errors gathered by hand into a
+// std::vector<ResultException> against ResultUtils::validate, for records
+// with no, one and three failing checks.
+
+namespace {
+std::atomic<std::size_t> g_allocations{0};
+}
+
+void* operator new(std::size_t n) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State & state) : state_(state), start_(g_allocations.load()) {}
+    ~AllocationCounter() {
+        state_.counters["allocs/iter"] = benchmark::Counter(
+            static_cast<double>(g_allocations.load() - start_), benchmark::Counter::kAvgIterations);
+    }
+private:
+    benchmark::State & state_;
+    std::size_t start_;
+};
+
+struct Record {
+    int id;
+    int quantity;
+    int price;
+    int discount;
+};
+
+// Each check fails for one value of the bad field in the record.
+Result<void> check_id(const Record & r) {
+    static const ResultComponent component("record");
+    if(r.id < 0)
+        return Result<void>::failed(ResultException(component, "negative id"));
+    return Result<void>::ok();
+}
+
+Result<void> check_quantity(const Record & r) {
+    static const ResultComponent component("record");
+    if(r.quantity <= 0)
+        return Result<void>::failed(ResultException(component, "quantity must be positive"));
+    return Result<void>::ok();
+}
+
+Result<void> check_price(const Record & r) {
+    static const ResultComponent component("record");
+    if(r.price <= 0)
+        return Result<void>::failed(ResultException(component, "price must be positive"));
+    return Result<void>::ok();
+}
+
+Result<void> check_discount(const Record & r) {
+    static const ResultComponent component("record");
+    if(r.discount > r.price)
+        return Result<void>::failed(ResultException(component, "discount above price"));
+    return Result<void>::ok();
+}
+
+Record record(int failures) {
+    Record r{1, 2, 10, 1};
+    if(failures > 0)
+        r.id = -1;
+    if(failures > 1)
+        r.quantity = 0;
+    if(failures > 2)
+        r.discount = 20;
+    return r;
+}
+
+void BM_VectorOfErrors(benchmark::State & state) {
+    const Record r = record(static_cast<int>(state.range(0)));
+    AllocationCounter allocations(state);
+    for(auto _ : state) {
+        std::vector<ResultException> errors;
+        for(Result<void> c : {check_id(r), check_quantity(r), check_price(r), check_discount(r)}) {
+            if(!c.isOK())
+                errors.push_back(c.getException());
+        }
+        benchmark::DoNotOptimize(errors.data());
+    }
+}
+BENCHMARK(BM_VectorOfErrors)->Arg(0)->Arg(1)->Arg(3);
+
+void BM_Validate(benchmark::State & state) {
+    const Record r = record(static_cast<int>(state.range(0)));
+    AllocationCounter allocations(state);
+    for(auto _ : state) {
+        ResultUtils::Validated<Record> v = ResultUtils::validate(r, check_id, check_quantity, check_price, check_discount);
+        benchmark::DoNotOptimize(v.isValid());
+    }
+}
+BENCHMARK(BM_Validate)->Arg(0)->Arg(1)->Arg(3);
+
+}
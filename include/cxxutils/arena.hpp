@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#include "cxxutils/failure_handler.hpp"
+
+namespace cxxutils {
+
+// A monotonic (bump pointer) arena. Allocation carves space out of large
+// blocks, individual deallocation is a no-op, and reset() releases
+// everything at once. Intended for per-request scratch memory, e.g. the
+// ResultException payloads and boxed values produced while handling one
+// request. Not thread-safe; anything allocated from the arena must be dead
+// before reset() or destruction.
+//
+// ArenaAllocator allocations are counted until they are deallocated, and
+// debug builds assert that none are outstanding at reset() or destruction.
+// A ResultException payload gives its block back when the last copy goes, so
+// a copy that escaped the request (a cache, an aggregated error, a log
+// queue) is caught there rather than read after its memory is reused.
+class MonotonicArena {
+public:
+    explicit MonotonicArena(std::size_t blockSize_in = 4096) :
+        blockSize(std::max<std::size_t>(blockSize_in, 256)) {}
+
+    MonotonicArena(const MonotonicArena &) = delete;
+    MonotonicArena& operator=(const MonotonicArena &) = delete;
+
+    ~MonotonicArena() {
+        assert(outstanding == 0 && "MonotonicArena destroyed while ArenaAllocator allocations are live");
+        release(head);
+    }
+
+    void* allocate(std::size_t n, std::size_t align = alignof(std::max_align_t)) {
+        std::uintptr_t p = (cursor + align - 1) & ~(std::uintptr_t(align) - 1);
+        if(head == nullptr || p > limit || n > limit - p) {
+            if(n > std::numeric_limits<std::size_t>::max() - sizeof(Block) - align)
+                CXXUTILS_THROW(std::bad_alloc(), "MonotonicArena allocation too large");
+            grow(n + align);
+            p = (cursor + align - 1) & ~(std::uintptr_t(align) - 1);
+        }
+        cursor = p + n;
+        used += n;
+        return reinterpret_cast<void*>(p);
+    }
+
+    void deallocate(void*, std::size_t) {}
+
+    // Releases everything allocated so far. The most recent block is kept
+    // for reuse so a steady per-request workload stops touching the global
+    // allocator.
+    void reset() {
+        assert(outstanding == 0 && "MonotonicArena reset while ArenaAllocator allocations are live");
+        if(head == nullptr)
+            return;
+        release(head->next);
+        head->next = nullptr;
+        cursor = reinterpret_cast<std::uintptr_t>(head + 1);
+        limit = cursor + head->size;
+        used = 0;
+    }
+
+    // Bytes handed out since construction or the last reset().
+    std::size_t bytesUsed() const {
+        return used;
+    }
+
+    // ArenaAllocator allocations not yet deallocated.
+    std::size_t liveAllocations() const {
+        return outstanding;
+    }
+
+private:
+    template<typename> friend class ArenaAllocator;
+
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        std::size_t size;
+    };
+
+    void grow(std::size_t atLeast) {
+        std::size_t size = std::max(blockSize, atLeast);
+        Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+        block->next = head;
+        block->size = size;
+        head = block;
+        cursor = reinterpret_cast<std::uintptr_t>(block + 1);
+        limit = cursor + size;
+    }
+
+    static void release(Block* block) {
+        while(block) {
+            Block* next = block->next;
+            ::operator delete(block);
+            block = next;
+        }
+    }
+
+    std::size_t blockSize;
+    Block* head = nullptr;
+    std::uintptr_t cursor = 0;
+    std::uintptr_t limit = 0;
+    std::size_t used = 0;
+    std::size_t outstanding = 0;
+};
+
+// Standard allocator drawing from a MonotonicArena.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(MonotonicArena & arena_in) : arena(&arena_in) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) {
+        if(n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            CXXUTILS_THROW(std::bad_array_new_length(), "ArenaAllocator allocation too large");
+        T* p = static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        ++arena->outstanding;
+        return p;
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        --arena->outstanding;
+        arena->deallocate(p, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> & other) const { return arena == other.arena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> & other) const { return arena != other.arena; }
+
+private:
+    template<typename> friend class ArenaAllocator;
+    MonotonicArena* arena;
+};
+
+}
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_aggregate.hpp"
+
+// Asynchronous Results. An AsyncPromise<T, E> is completed once with a
+// Result<T, E>; the matching AsyncResult<T, E> is consumed by exactly one
+// continuation (map, flatmap, on_failure, get, ...). Continuations run
+// either on the thread that completes the result or, when an executor is
+// supplied, on that executor. An executor is any object with a
+// submit(std::function<void()>) member, e.g. cxxutils::WorkStealingPool.
+
+template<typename T, typename E = ResultException>
+class AsyncResult;
+
+template<typename T, typename E = ResultException>
+class AsyncPromise;
+
+namespace cxxutils {
+
+// Runs submitted work immediately on the calling thread.
+struct InlineExecutor {
+    template<typename FN>
+    void submit(FN && f) {
+        f();
+    }
+
+    static InlineExecutor& instance() {
+        static InlineExecutor executor;
+        return executor;
+    }
+};
+
+}
+
+// Hook used where the async layer fails a result on its own account: a
+// promise destroyed without being set, or when_any of no inputs. Error
+// types constructible from ResultException get the reason under the "async"
+// component. Any other error type has to specialize it: a value-initialised
+// E, often an enum's Ok or None, would pass the failure off as something
+// else.
+template<typename E, typename = void>
+struct async_error {
+    static_assert(!std::is_same<E, E>::value,
+                  "specialize async_error<E> to say which E a broken promise or when_any of no inputs fails with");
+
+    static E make(const char *);
+};
+
+template<typename E>
+struct async_error<E, typename std::enable_if<std::is_constructible<E, const ResultException &>::value>::type> {
+    static E make(const char * reason) {
+        static const ResultComponent component("async");
+        return result_error_converter<ResultException, E>::convert(ResultException(component, reason));
+    }
+};
+
+namespace async_detail {
+
+// Type-erased one-shot callback with inline storage for small callables,
+// so attaching a typical continuation does not allocate.
+template<typename Arg>
+class continuation {
+public:
+    continuation() = default;
+    continuation(const continuation &) = delete;
+    continuation& operator=(const continuation &) = delete;
+
+    ~continuation() {
+        if(destroy_)
+            destroy_(buffer);
+    }
+
+    template<typename FN>
+    void set(FN && f) {
+        using D = typename std::decay<FN>::type;
+        setImpl<D>(std::forward<FN>(f),
+                   std::integral_constant<bool, sizeof(D) <= capacity &&
+                                                alignof(D) <= alignof(std::max_align_t)>());
+    }
+
+    void operator()(Arg arg) {
+        invoke_(buffer, arg);
+    }
+
+private:
+    static constexpr std::size_t capacity = 64;
+
+    template<typename D, typename FN>
+    void setImpl(FN && f, std::true_type) {
+        ::new (static_cast<void*>(buffer)) D(std::forward<FN>(f));
+        invoke_ = [](void* p, Arg a) { (*static_cast<D*>(p))(a); };
+        destroy_ = [](void* p) { static_cast<D*>(p)->~D(); };
+    }
+
+    template<typename D, typename FN>
+    void setImpl(FN && f, std::false_type) {
+        D* heap = new D(std::forward<FN>(f));
+        ::new (static_cast<void*>(buffer)) D*(heap);
+        invoke_ = [](void* p, Arg a) { (**static_cast<D**>(p))(a); };
+        destroy_ = [](void* p) { delete *static_cast<D**>(p); };
+    }
+
+    alignas(std::max_align_t) unsigned char buffer[capacity];
+    void (*invoke_)(void*, Arg) = nullptr;
+    void (*destroy_)(void*) = nullptr;
+};
+
+// Shared state of one AsyncResult, allocated once. The producer publishes
+// the result and the consumer publishes its continuation; whichever comes
+// second runs the continuation. Coordination is a single atomic phase word.
+template<typename T, typename E>
+struct state : std::enable_shared_from_this<state<T, E>> {
+    enum : int { empty = 0, has_result = 1, has_continuation = 2, done = 3 };
+
+    std::atomic<int> phase{empty};
+    // Copies of the AsyncPromise still alive.
+    std::atomic<std::size_t> promises{1};
+    optional<Result<T, E>> result;
+    continuation<const std::shared_ptr<state>&> next;
+
+    void complete(Result<T, E> && r) {
+        result.emplace(std::move(r));
+        int expected = empty;
+        if(!phase.compare_exchange_strong(expected, has_result, std::memory_order_acq_rel)) {
+            assert(expected == has_continuation);
+            phase.store(done, std::memory_order_relaxed);
+            next(this->shared_from_this());
+        }
+    }
+
+    template<typename FN>
+    void then(FN && f) {
+        next.set(std::forward<FN>(f));
+        int expected = empty;
+        if(!phase.compare_exchange_strong(expected, has_continuation, std::memory_order_acq_rel)) {
+            assert(expected == has_result);
+            phase.store(done, std::memory_order_relaxed);
+            next(this->shared_from_this());
+        }
+    }
+
+    bool ready() const {
+        int p = phase.load(std::memory_order_acquire);
+        return p == has_result || p == done;
+    }
+
+    // Called as each AsyncPromise copy goes away; true for the last one to
+    // go if none of them set the result.
+    bool releasePromise() {
+        return promises.fetch_sub(1, std::memory_order_acq_rel) == 1 && !ready();
+    }
+
+    Result<T, E> take() {
+        return result.takeValue();
+    }
+};
+
+template<typename X>
+struct is_async_result : std::false_type {};
+
+template<typename T, typename E>
+struct is_async_result<AsyncResult<T, E>> : std::true_type {};
+
+}
+
+// Copies share the one result. If every copy is destroyed without the
+// result being set, it completes as failed with a "broken promise" error
+// (see async_error).
+template<typename T, typename E>
+class AsyncPromise {
+public:
+    AsyncPromise() : state(std::make_shared<async_detail::state<T, E>>()) {}
+
+    AsyncPromise(const AsyncPromise & o) : state(o.state) {
+        if(state)
+            state->promises.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    AsyncPromise(AsyncPromise && o) noexcept : state(std::move(o.state)) {}
+
+    AsyncPromise& operator=(AsyncPromise o) {
+        std::swap(state, o.state);
+        return *this;
+    }
+
+    // A broken promise is only failed while something else still holds the
+    // state, i.e. there is a consumer to see the failure.
+    ~AsyncPromise() {
+        if(state && state->releasePromise() && state.use_count() > 1)
+            state->complete(Result<T, E>::failed(async_error<E>::make("broken promise")));
+    }
+
+    AsyncResult<T, E> getResult() {
+        return AsyncResult<T, E>(state);
+    }
+
+    void setResult(Result<T, E> && r) {
+        state->complete(std::move(r));
+    }
+
+    void setResult(const Result<T, E> & r) {
+        state->complete(Result<T, E>(r));
+    }
+
+private:
+    std::shared_ptr<async_detail::state<T, E>> state;
+};
+
+template<typename T, typename E>
+class AsyncResult {
+private:
+    using State = async_detail::state<T, E>;
+
+    template<typename, typename> friend class AsyncPromise;
+    template<typename, typename> friend class AsyncResult;
+
+    explicit AsyncResult(std::shared_ptr<State> state_in) : state(std::move(state_in)) {}
+
+    std::shared_ptr<State> state;
+
+    template<typename U, typename FN, typename Executor>
+    AsyncResult<U, E> chain(FN f, Executor & ex) && {
+        AsyncPromise<U, E> promise;
+        AsyncResult<U, E> out = promise.getResult();
+        state->then([promise, f, &ex](const std::shared_ptr<State> & self) mutable {
+            ex.submit([promise, f, self]() mutable {
+                f(self->take(), promise);
+            });
+        });
+        state.reset();
+        return out;
+    }
+
+public:
+    using value_type = T;
+    using error_type = E;
+
+    static AsyncResult<T, E> ready(Result<T, E> && r) {
+        AsyncPromise<T, E> promise;
+        promise.setResult(std::move(r));
+        return promise.getResult();
+    }
+
+    bool isReady() const {
+        return state->ready();
+    }
+
+    // Blocks until the result is available and returns it.
+    Result<T, E> get() && {
+        struct waiter {
+            std::mutex mutex;
+            std::condition_variable cv;
+            optional<Result<T, E>> value;
+        };
+        std::shared_ptr<waiter> w = std::make_shared<waiter>();
+        state->then([w](const std::shared_ptr<State> & self) {
+            std::lock_guard<std::mutex> lock(w->mutex);
+            w->value.emplace(self->take());
+            w->cv.notify_all();
+        });
+        state.reset();
+        std::unique_lock<std::mutex> lock(w->mutex);
+        w->cv.wait(lock, [&] { return w->value.hasValue(); });
+        return w->value.takeValue();
+    }
+
+    template<typename FN, typename Executor>
+    auto map(FN f, Executor & ex) && -> AsyncResult<decltype(f(std::declval<const T&>())), E> {
+        using U = decltype(f(std::declval<const T&>()));
+        return std::move(*this).template chain<U>(
+            [f](Result<T, E> && r, AsyncPromise<U, E> & p) mutable {
+                p.setResult(r.map(f));
+            }, ex);
+    }
+
+    template<typename FN>
+    auto map(FN f) && -> AsyncResult<decltype(f(std::declval<const T&>())), E> {
+        return std::move(*this).map(std::move(f), cxxutils::InlineExecutor::instance());
+    }
+
+    // fn may return either a Result<U, E> or an AsyncResult<U, E>.
+    template<typename FN, typename Executor>
+    auto flatmap(FN f, Executor & ex) && -> AsyncResult<typename decltype(f(std::declval<const T&>()))::value_type, E> {
+        using RET = decltype(f(std::declval<const T&>()));
+        using U = typename RET::value_type;
+        return std::move(*this).template chain<U>(
+            [f](Result<T, E> && r, AsyncPromise<U, E> & p) mutable {
+                if(!r.isOK()) {
+                    p.setResult(Result<U, E>::translateError(r));
+                    return;
+                }
+                forward(f(r.getValue()), p, async_detail::is_async_result<RET>());
+            }, ex);
+    }
+
+    template<typename FN>
+    auto flatmap(FN f) && -> AsyncResult<typename decltype(f(std::declval<const T&>()))::value_type, E> {
+        return std::move(*this).flatmap(std::move(f), cxxutils::InlineExecutor::instance());
+    }
+
+    // Calls fn with the error if the result fails; the result is passed on
+    // unchanged either way.
+    template<typename FN, typename Executor>
+    AsyncResult<T, E> on_failure(FN f, Executor & ex) && {
+        return std::move(*this).template chain<T>(
+            [f](Result<T, E> && r, AsyncPromise<T, E> & p) mutable {
+                r.on_failure(f);
+                p.setResult(std::move(r));
+            }, ex);
+    }
+
+    template<typename FN>
+    AsyncResult<T, E> on_failure(FN f) && {
+        return std::move(*this).on_failure(std::move(f), cxxutils::InlineExecutor::instance());
+    }
+
+    // Calls fn with the completed Result. Ends the chain.
+    template<typename FN>
+    void then(FN f) && {
+        state->then([f](const std::shared_ptr<State> & self) mutable {
+            f(self->take());
+        });
+        state.reset();
+    }
+
+private:
+    template<typename U>
+    static void forward(Result<U, E> && r, AsyncPromise<U, E> & p, std::false_type) {
+        p.setResult(std::move(r));
+    }
+
+    template<typename U>
+    static void forward(AsyncResult<U, E> && r, AsyncPromise<U, E> & p, std::true_type) {
+        std::move(r).then([p](Result<U, E> && inner) mutable {
+            p.setResult(std::move(inner));
+        });
+    }
+};
+
+namespace async_detail {
+
+template<typename T, typename E>
+struct when_all_state {
+    explicit when_all_state(std::size_t n) : remaining(n), values(n), errors(n) {}
+
+    std::atomic<std::size_t> remaining;
+    std::vector<optional<T>> values;
+    std::vector<optional<E>> errors;
+    AsyncPromise<std::vector<T>, E> promise;
+
+    void finish() {
+        std::vector<E> failures;
+        for(optional<E> & e : errors)
+            if(e.hasValue())
+                failures.push_back(e.takeValue());
+        if(!failures.empty()) {
+            promise.setResult(Result<std::vector<T>, E>::failed(
+                result_error_aggregator<E>::aggregate(std::move(failures))));
+            return;
+        }
+        std::vector<T> out;
+        out.reserve(values.size());
+        for(optional<T> & v : values)
+            out.push_back(v.takeValue());
+        promise.setResult(Result<std::vector<T>, E>::ok(std::move(out)));
+    }
+};
+
+template<typename T, typename E>
+struct when_any_state {
+    explicit when_any_state(std::size_t n) : remaining(n), errors(n) {}
+
+    std::atomic<bool> won{false};
+    std::atomic<std::size_t> remaining;
+    std::vector<optional<E>> errors;
+    AsyncPromise<T, E> promise;
+};
+
+}
+
+// Completes once every input has completed: with all the values in input
+// order, or with the failures combined by result_error_aggregator.
+template<typename T, typename E>
+AsyncResult<std::vector<T>, E> when_all(std::vector<AsyncResult<T, E>> && inputs) {
+    using State = async_detail::when_all_state<T, E>;
+    std::shared_ptr<State> state = std::make_shared<State>(inputs.size());
+    AsyncResult<std::vector<T>, E> out = state->promise.getResult();
+    if(inputs.empty()) {
+        state->finish();
+        return out;
+    }
+    for(std::size_t i = 0; i < inputs.size(); ++i) {
+        std::move(inputs[i]).then([state, i](Result<T, E> && r) {
+            if(r.isOK())
+                state->values[i].emplace(r.takeValue());
+            else
+                state->errors[i].emplace(r.getException());
+            if(state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                state->finish();
+        });
+    }
+    return out;
+}
+
+// Completes with the first successful input, or once all inputs have failed
+// with their failures combined by result_error_aggregator. With no inputs
+// it fails straight away (see async_error).
+template<typename T, typename E>
+AsyncResult<T, E> when_any(std::vector<AsyncResult<T, E>> && inputs) {
+    using State = async_detail::when_any_state<T, E>;
+    if(inputs.empty())
+        return AsyncResult<T, E>::ready(Result<T, E>::failed(async_error<E>::make("when_any of no inputs")));
+    std::shared_ptr<State> state = std::make_shared<State>(inputs.size());
+    AsyncResult<T, E> out = state->promise.getResult();
+    for(std::size_t i = 0; i < inputs.size(); ++i) {
+        std::move(inputs[i]).then([state, i](Result<T, E> && r) {
+            if(r.isOK()) {
+                if(!state->won.exchange(true, std::memory_order_acq_rel))
+                    state->promise.setResult(std::move(r));
+            } else {
+                state->errors[i].emplace(r.getException());
+            }
+            if(state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+               !state->won.exchange(true, std::memory_order_acq_rel)) {
+                std::vector<E> failures;
+                for(optional<E> & e : state->errors)
+                    if(e.hasValue())
+                        failures.push_back(e.takeValue());
+                state->promise.setResult(Result<T, E>::failed(
+                    result_error_aggregator<E>::aggregate(std::move(failures))));
+            }
+        });
+    }
+    return out;
+}
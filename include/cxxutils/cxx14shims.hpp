@@ -2,6 +2,19 @@
 
 #include <memory>
 
+// [[nodiscard]] where the language has it, the GCC/Clang attribute otherwise.
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(nodiscard) && __cplusplus >= 201703L
+#define CXXUTILS_NODISCARD [[nodiscard]]
+#endif
+#endif
+#if !defined(CXXUTILS_NODISCARD) && defined(__GNUC__)
+#define CXXUTILS_NODISCARD __attribute__((warn_unused_result))
+#endif
+#ifndef CXXUTILS_NODISCARD
+#define CXXUTILS_NODISCARD
+#endif
+
 namespace cxx14 {
 
 template<typename T, typename... Args>
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+// Exception-free builds. CXXUTILS_NO_EXCEPTIONS is defined automatically
+// when the compiler has exceptions turned off (-fno-exceptions), and can be
+// defined explicitly to get the same behaviour in a build that has them.
+//
+// In that mode the places that would throw (optional::getValue on an empty
+// optional, Result::getValueOrThrow on a failure, ...) instead call the
+// handler installed with cxxutils::setFailureHandler. The handler must not
+// return; if it does, std::abort() is called.
+
+#if !defined(CXXUTILS_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define CXXUTILS_NO_EXCEPTIONS
+#endif
+
+#ifdef CXXUTILS_NO_EXCEPTIONS
+#define CXXUTILS_THROW(exception, what) ::cxxutils::failure_detail::fail(what)
+#else
+#define CXXUTILS_THROW(exception, what) throw exception
+#endif
+
+namespace cxxutils {
+
+// what describes the failed access; it is only valid during the call.
+using FailureHandler = void (*)(const char * what);
+
+namespace failure_detail {
+
+inline void default_handler(const char * what) {
+    std::fprintf(stderr, "cxxutils: %s\n", what);
+    std::fflush(stderr);
+    std::abort();
+}
+
+inline std::atomic<FailureHandler>& handler() {
+    static std::atomic<FailureHandler> h{&default_handler};
+    return h;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void fail(const char * what) {
+    handler().load(std::memory_order_acquire)(what);
+    std::abort();
+}
+
+}
+
+// Installs the handler used in exception-free builds and returns the
+// previous one. Passing nullptr restores the default, which prints what to
+// stderr and aborts.
+inline FailureHandler setFailureHandler(FailureHandler h) {
+    return failure_detail::handler().exchange(h ? h : &failure_detail::default_handler);
+}
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "cxxutils/failure_handler.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace cxxutils {
+
+struct PoolStats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+};
+
+namespace pool_detail {
+
+// Hit/miss counters for one pooled type. Each thread counts into its own
+// shard, written only by that thread, so counting never contends; stats()
+// sums the live shards plus those of threads that have exited.
+template<typename Tag>
+class counters {
+public:
+    static void hit() {
+        shard& s = local();
+        s.hits.store(s.hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static void miss() {
+        shard& s = local();
+        s.misses.store(s.misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static PoolStats stats() {
+        registry_t& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        PoolStats out{r.retiredHits, r.retiredMisses};
+        for(shard* s : r.shards) {
+            out.hits += s->hits.load(std::memory_order_relaxed);
+            out.misses += s->misses.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+private:
+    struct shard {
+        std::atomic<std::uint64_t> hits{0};
+        std::atomic<std::uint64_t> misses{0};
+
+        shard() {
+            registry_t& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.shards.push_back(this);
+        }
+
+        ~shard() {
+            registry_t& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.retiredHits += hits.load(std::memory_order_relaxed);
+            r.retiredMisses += misses.load(std::memory_order_relaxed);
+            for(std::size_t i = 0; i < r.shards.size(); ++i) {
+                if(r.shards[i] == this) {
+                    r.shards[i] = r.shards.back();
+                    r.shards.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    struct registry_t {
+        std::mutex mutex;
+        std::vector<shard*> shards;
+        std::uint64_t retiredHits = 0;
+        std::uint64_t retiredMisses = 0;
+    };
+
+    // Deliberately leaked so thread-exit shard destructors can always reach it.
+    static registry_t& registry() {
+        static registry_t* r = new registry_t();
+        return *r;
+    }
+
+    static shard& local() {
+        static thread_local shard s;
+        return s;
+    }
+};
+
+}
+
+// Per-type pool of raw storage for objects of type T. Each thread keeps a
+// free list of up to maxCached() blocks; acquiring from a non-empty list is
+// a hit, anything else is a miss that falls back to operator new. Blocks
+// released on a thread join that thread's list. Stats are reported under
+// Tag, so the different allocations made on behalf of one user type (for
+// example a shared_ptr control block) are counted together.
+template<typename T, typename Tag = T>
+class ObjectPool {
+public:
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types cannot be pooled");
+
+    static void* acquire() {
+        cache& c = local();
+        if(node* n = c.head) {
+            c.head = n->next;
+            --c.count;
+            pool_detail::counters<Tag>::hit();
+            return n;
+        }
+        pool_detail::counters<Tag>::miss();
+        return ::operator new(blockSize);
+    }
+
+    static void release(void* p) {
+        cache& c = local();
+        if(c.count >= maxCached().load(std::memory_order_relaxed)) {
+            ::operator delete(p);
+            return;
+        }
+        node* n = static_cast<node*>(p);
+        n->next = c.head;
+        c.head = n;
+        ++c.count;
+    }
+
+    static PoolStats stats() {
+        return pool_detail::counters<Tag>::stats();
+    }
+
+    // Upper bound on the blocks each thread keeps cached.
+    static std::atomic<std::size_t>& maxCached() {
+        static std::atomic<std::size_t> limit{1024};
+        return limit;
+    }
+
+private:
+    struct node {
+        node* next;
+    };
+
+    static constexpr std::size_t blockSize = sizeof(T) > sizeof(node) ? sizeof(T) : sizeof(node);
+
+    struct cache {
+        node* head = nullptr;
+        std::size_t count = 0;
+
+        ~cache() {
+            while(head) {
+                node* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    };
+
+    static cache& local() {
+        static thread_local cache c;
+        return c;
+    }
+};
+
+// Deleter returning an object's storage to its ObjectPool.
+template<typename T>
+struct PooledDeleter {
+    void operator()(T* p) const {
+        p->~T();
+        ObjectPool<T>::release(p);
+    }
+};
+
+template<typename T>
+using pooled_unique_ptr = std::unique_ptr<T, PooledDeleter<T>>;
+
+template<typename T, typename... Args>
+pooled_unique_ptr<T> make_pooled_unique(Args&&... args) {
+    void* mem = ObjectPool<T>::acquire();
+#ifdef CXXUTILS_NO_EXCEPTIONS
+    return pooled_unique_ptr<T>(::new (mem) T(std::forward<Args>(args)...));
+#else
+    try {
+        return pooled_unique_ptr<T>(::new (mem) T(std::forward<Args>(args)...));
+    } catch(...) {
+        ObjectPool<T>::release(mem);
+        throw;
+    }
+#endif
+}
+
+// Allocator serving single-object allocations from ObjectPool, for use with
+// std::allocate_shared. Rebinds keep Tag, so the control block allocation
+// is counted under the user's type.
+template<typename T, typename Tag = T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = PoolAllocator<U, Tag>;
+    };
+
+    PoolAllocator() = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U, Tag> &) {}
+
+    T* allocate(std::size_t n) {
+        if(n == 1)
+            return static_cast<T*>(ObjectPool<T, Tag>::acquire());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        if(n == 1)
+            ObjectPool<T, Tag>::release(p);
+        else
+            ::operator delete(p);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U, Tag> &) const { return true; }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U, Tag> &) const { return false; }
+};
+
+template<typename T, typename... Args>
+std::shared_ptr<T> make_pooled_shared(Args&&... args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+}
@@ -1,64 +1,407 @@
 #pragma once
 
-#include <exception>
+#include <assert.h>
+#include "cxxutils/failure_handler.hpp"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
+// Thrown when an empty optional is accessed; in exception-free builds the
+// cxxutils failure handler is called instead.
 struct MissingOptionalValue : std::runtime_error {
     MissingOptionalValue() : std::runtime_error("Optional value is not set") {}
 };
 
+// Types with a spare bit pattern can specialize optional_niche to let
+// optional<T> use that pattern to mean "empty", so optional<T> has the same
+// size as T. An enabled niche provides
+//     static void set_empty(void* storage);
+//     static bool is_empty(const void* storage);
+// operating on the raw sizeof(T) bytes of the storage. A value whose
+// representation matches the niche must never be stored in the optional.
+template<typename T, typename = void>
+struct optional_niche {
+    static constexpr bool enabled = false;
+};
+
+// Niche for a type whose object representation is a single Word, using the
+// given bit pattern as the empty marker.
+template<typename T, typename Word, Word Pattern>
+struct optional_bit_niche {
+    static_assert(sizeof(T) == sizeof(Word), "niche pattern must cover the whole object");
+
+    static constexpr bool enabled = true;
+
+    static void set_empty(void* storage) {
+        const Word pattern = Pattern;
+        std::memcpy(storage, &pattern, sizeof(Word));
+    }
+
+    static bool is_empty(const void* storage) {
+        Word bits;
+        std::memcpy(&bits, storage, sizeof(Word));
+        return bits == Pattern;
+    }
+};
+
+// Niche for enums that reserve an enumerator (or an unused value) as the
+// empty marker:
+//     template<> struct optional_niche<Color> : optional_enum_niche<Color, Color::Invalid> {};
+template<typename Enum, Enum Sentinel>
+struct optional_enum_niche
+    : optional_bit_niche<Enum, typename std::underlying_type<Enum>::type,
+                         static_cast<typename std::underlying_type<Enum>::type>(Sentinel)> {};
+
+// An all-ones address is never a valid object address.
+template<typename T>
+struct optional_niche<T*> : optional_bit_niche<T*, std::uintptr_t, ~std::uintptr_t(0)> {};
+
+template<typename T>
+struct optional_niche<std::unique_ptr<T>>
+    : optional_bit_niche<std::unique_ptr<T>, std::uintptr_t, ~std::uintptr_t(0)> {};
+
+namespace optional_detail {
+
+template<std::size_t Size>
+struct nan_pattern;
+
+template<>
+struct nan_pattern<4> {
+    using word = std::uint32_t;
+    static constexpr word value = 0x7FC0DEADU;
+};
+
+template<>
+struct nan_pattern<8> {
+    using word = std::uint64_t;
+    static constexpr word value = 0x7FF80000DEAD0001ULL;
+};
+
+}
+
+// Niche for a float or double (or a wrapper holding one) using a quiet NaN
+// with a payload that arithmetic never produces. Plain floating point keeps
+// explicit storage, since a NaN read from elsewhere could carry any payload;
+// opt in for a type whose values are known not to:
+//     struct Price { double value; };
+//     template<> struct optional_niche<Price> : optional_nan_niche<Price> {};
+template<typename T>
+struct optional_nan_niche
+    : optional_bit_niche<T, typename optional_detail::nan_pattern<sizeof(T)>::word,
+                         optional_detail::nan_pattern<sizeof(T)>::value> {};
+
+namespace optional_detail {
+
+struct in_place_t {
+    explicit in_place_t() = default;
+};
 
 template<typename T>
-class optional {
+struct is_trivial_payload
+    : std::integral_constant<bool,
+          std::is_trivially_copyable<T>::value &&
+          std::is_trivially_destructible<T>::value> {};
+
+// Inline storage for an optional value: the payload lives in a union next to
+// an engaged flag, so no heap allocation is ever made. When T is trivially
+// copyable the storage is too, and the compiler generated special members
+// are used directly; everything but construct() is then usable in constant
+// expressions.
+template<typename T, bool Trivial = is_trivial_payload<T>::value>
+struct storage {
+    using value_type = T;
+
+    union {
+        char empty_;
+        T value_;
+    };
+    bool engaged_;
+
+    constexpr storage() : empty_(), engaged_(false) {}
+
+    template<typename... Args>
+    constexpr explicit storage(in_place_t, Args&&... args) :
+        value_(std::forward<Args>(args)...), engaged_(true) {}
+
+    constexpr bool engaged() const { return engaged_; }
+    constexpr T& ref() { return value_; }
+    constexpr const T& ref() const { return value_; }
+
+    template<typename... Args>
+    void construct(Args&&... args) {
+        ::new (static_cast<void*>(std::addressof(value_))) T(std::forward<Args>(args)...);
+        engaged_ = true;
+    }
+
+    constexpr void destroy() {
+        engaged_ = false;
+    }
+};
+
+template<typename T>
+struct storage<T, false> {
+    using value_type = T;
+
+    union {
+        char empty_;
+        T value_;
+    };
+    bool engaged_;
+
+    storage() : empty_(), engaged_(false) {}
+
+    template<typename... Args>
+    explicit storage(in_place_t, Args&&... args) :
+        value_(std::forward<Args>(args)...), engaged_(true) {}
+
+    ~storage() {
+        if(engaged_)
+            value_.~T();
+    }
+
+    bool engaged() const { return engaged_; }
+    T& ref() { return value_; }
+    const T& ref() const { return value_; }
+
+    template<typename... Args>
+    void construct(Args&&... args) {
+        ::new (static_cast<void*>(std::addressof(value_))) T(std::forward<Args>(args)...);
+        engaged_ = true;
+    }
+
+    void destroy() {
+        value_.~T();
+        engaged_ = false;
+    }
+};
+
+// Storage for types with a niche: emptiness is encoded in the payload
+// bytes themselves, so there is no separate engaged flag.
+template<typename T, bool Trivial = is_trivial_payload<T>::value>
+struct niche_storage {
+    using Niche = optional_niche<T>;
+    using value_type = T;
+
+    union {
+        unsigned char bytes_[sizeof(T)];
+        T value_;
+    };
+
+    niche_storage() {
+        Niche::set_empty(bytes_);
+    }
+
+    template<typename... Args>
+    explicit niche_storage(in_place_t, Args&&... args) {
+        construct(std::forward<Args>(args)...);
+    }
+
+    bool engaged() const { return !Niche::is_empty(bytes_); }
+    T& ref() { return value_; }
+    const T& ref() const { return value_; }
+
+    template<typename... Args>
+    void construct(Args&&... args) {
+        ::new (static_cast<void*>(bytes_)) T(std::forward<Args>(args)...);
+        assert(engaged() && "value collides with the optional_niche empty marker");
+    }
+
+    void destroy() {
+        Niche::set_empty(bytes_);
+    }
+};
+
+template<typename T>
+struct niche_storage<T, false> {
+    using Niche = optional_niche<T>;
+    using value_type = T;
+
+    union {
+        unsigned char bytes_[sizeof(T)];
+        T value_;
+    };
+
+    niche_storage() {
+        Niche::set_empty(bytes_);
+    }
+
+    template<typename... Args>
+    explicit niche_storage(in_place_t, Args&&... args) {
+        construct(std::forward<Args>(args)...);
+    }
+
+    ~niche_storage() {
+        if(engaged())
+            value_.~T();
+    }
+
+    bool engaged() const { return !Niche::is_empty(bytes_); }
+    T& ref() { return value_; }
+    const T& ref() const { return value_; }
+
+    template<typename... Args>
+    void construct(Args&&... args) {
+        ::new (static_cast<void*>(bytes_)) T(std::forward<Args>(args)...);
+        assert(engaged() && "value collides with the optional_niche empty marker");
+    }
+
+    void destroy() {
+        value_.~T();
+        Niche::set_empty(bytes_);
+    }
+};
+
+// Copy and move operations expressed in terms of a storage's
+// engaged/ref/construct/destroy interface. Trivial storages keep the
+// defaulted (trivial) operations.
+template<typename S, bool Trivial>
+struct ops : S {
+    using S::S;
+};
+
+template<typename S>
+struct ops<S, false> : S {
+    using S::S;
+
+    ops() = default;
+
+    ops(const ops& o) : S() {
+        if(o.engaged())
+            this->construct(o.ref());
+    }
+
+    ops(ops&& o) noexcept(std::is_nothrow_move_constructible<typename S::value_type>::value) : S() {
+        if(o.engaged())
+            this->construct(std::move(o.ref()));
+    }
+
+    ops& operator=(const ops& o) {
+        if(this == &o)
+            return *this;
+        if(o.engaged()) {
+            if(this->engaged())
+                this->ref() = o.ref();
+            else
+                this->construct(o.ref());
+        } else if(this->engaged()) {
+            this->destroy();
+        }
+        return *this;
+    }
+
+    ops& operator=(ops&& o) {
+        if(o.engaged()) {
+            if(this->engaged())
+                this->ref() = std::move(o.ref());
+            else
+                this->construct(std::move(o.ref()));
+        } else if(this->engaged()) {
+            this->destroy();
+        }
+        return *this;
+    }
+};
+
+template<typename T>
+using base = ops<typename std::conditional<optional_niche<T>::enabled,
+                                           niche_storage<T>,
+                                           storage<T>>::type,
+                 is_trivial_payload<T>::value>;
+
+}
+
+template<typename T>
+class optional : private optional_detail::base<T> {
 private:
-    std::unique_ptr<T> value;
+    using Base = optional_detail::base<T>;
 public:
-      optional() : value() {}
+      constexpr optional() : Base() {}
+
+      explicit constexpr optional( const T & v) :
+          Base(optional_detail::in_place_t(), v) {}
+
+      explicit constexpr optional( T && v) :
+          Base(optional_detail::in_place_t(), std::move(v)) {}
+
+      constexpr bool hasValue() const {
+          return this->engaged();
+      }
+
+      constexpr const T& getValue() const {
+          if(!this->engaged())
+              CXXUTILS_THROW(MissingOptionalValue(), "getValue called on an empty optional");
+          return this->ref();
+      }
 
-      optional( const optional<T> & v) : 
-          value() {
-          if(v.value) {
-              value.reset(new T(*v.value.get()));
-          }
+      constexpr T& getValue() {
+          if(!this->engaged())
+              CXXUTILS_THROW(MissingOptionalValue(), "getValue called on an empty optional");
+          return this->ref();
       }
 
-      optional<T>& operator=(const optional<T> & v) {
-          if(v.value) {
-              value.reset(new T(*v.value.get()));
-          } else {
-              value.clear();
-          }
-          return *this;
+      // Moves the value out, leaving the optional empty.
+      constexpr T takeValue() {
+          if(!this->engaged())
+              CXXUTILS_THROW(MissingOptionalValue(), "takeValue called on an empty optional");
+          T result(std::move(this->ref()));
+          this->destroy();
+          return result;
       }
 
-      optional( optional<T> && v) :
-          value(std::move(v.value)) {};
+      template<typename... Args>
+      T& emplace(Args&&... args) {
+          reset();
+          this->construct(std::forward<Args>(args)...);
+          return this->ref();
+      }
 
-      optional<T>& operator=(optional<T> && v) {
-          value=(std::move(v.value));
-          return *this;
+      constexpr void reset() {
+          if(this->engaged())
+              this->destroy();
       }
+};
 
-      explicit optional( const T & v) :
-          value( new T(v) ) {}
+// An optional reference is a nullable pointer; it never owns the referent.
+template<typename T>
+class optional<T&> {
+private:
+    T* value;
+public:
+      constexpr optional() : value(nullptr) {}
 
-      explicit optional( T && v) :
-          value( new T(std::move(v)) ) {}
+      explicit constexpr optional( T & v) : value(std::addressof(v)) {}
 
+      optional( T && v) = delete;
 
-      bool hasValue() const {
-          return value.get()!=nullptr;
+      constexpr bool hasValue() const {
+          return value != nullptr;
       }
 
-      const T& getValue() const {
-          T* v = value.get();
-          if(v==nullptr)
-              throw MissingOptionalValue();
-          return *v;
+      constexpr T& getValue() const {
+          if(value == nullptr)
+              CXXUTILS_THROW(MissingOptionalValue(), "getValue called on an empty optional");
+          return *value;
       }
 
-      T && takeValue() {
-        return std::move(*value.release());
+      // Returns the reference, leaving the optional empty.
+      constexpr T& takeValue() {
+          if(value == nullptr)
+              CXXUTILS_THROW(MissingOptionalValue(), "takeValue called on an empty optional");
+          T& result = *value;
+          value = nullptr;
+          return result;
+      }
+
+      T& emplace(T & v) {
+          value = std::addressof(v);
+          return *value;
       }
-};
-          
 
+      constexpr void reset() {
+          value = nullptr;
+      }
+};
@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "cxxutils/optional.hpp"
+
+namespace cxxutils {
+
+namespace column_detail {
+
+// Independent accumulators, so the kernels below vectorize without the
+// compiler having to reassociate floating point arithmetic.
+constexpr std::size_t lanes = 8;
+
+// Bit counting without relying on a popcount instruction being enabled, so
+// the loop over a bitmap vectorizes on baseline targets too.
+inline std::uint64_t popcount(std::uint64_t w) {
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (w * 0x0101010101010101ULL) >> 56;
+}
+
+inline std::size_t lowest_bit(std::uint64_t w) {
+#if defined(__GNUC__)
+    return static_cast<std::size_t>(__builtin_ctzll(w));
+#else
+    std::size_t n = 0;
+    for(; !(w & 1); w >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+struct min_op {
+    template<typename T>
+    static T pick(T acc, T x) { return x < acc ? x : acc; }
+};
+
+struct max_op {
+    template<typename T>
+    static T pick(T acc, T x) { return acc < x ? x : acc; }
+};
+
+// Folds whole 64-row bitmap words into lanes of independent accumulators.
+// Missing rows are replaced by identity, which never wins against a present
+// value, so the loop has no data dependent branches.
+template<typename T, typename Op, typename = void>
+class word_reducer {
+public:
+    explicit word_reducer(T identity) : identity_(identity) {
+        for(T & a : acc_)
+            a = identity;
+    }
+
+    void add(const T* v, std::uint64_t bits) {
+        for(std::size_t j = 0; j < 64; j += lanes) {
+            for(std::size_t l = 0; l < lanes; ++l) {
+                T x = ((bits >> (j + l)) & 1) ? v[j + l] : identity_;
+                acc_[l] = Op::pick(acc_[l], x);
+            }
+        }
+    }
+
+    T result() const {
+        T r = acc_[0];
+        for(std::size_t l = 1; l < lanes; ++l)
+            r = Op::pick(r, acc_[l]);
+        return r;
+    }
+
+private:
+    T identity_;
+    T acc_[lanes];
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+// GCC and Clang do not vectorize the masked select above for floating point
+// without -ffinite-math-only, so float and double get SSE2 versions. Each
+// group of validity bits indexes a table of lane masks; minps/maxps with the
+// accumulator as second operand match Op::pick, NaN handling included.
+template<typename Op>
+inline __m128d simd_pick(__m128d acc, __m128d x);
+template<>
+inline __m128d simd_pick<min_op>(__m128d acc, __m128d x) { return _mm_min_pd(x, acc); }
+template<>
+inline __m128d simd_pick<max_op>(__m128d acc, __m128d x) { return _mm_max_pd(x, acc); }
+
+template<typename Op>
+inline __m128 simd_pick(__m128 acc, __m128 x);
+template<>
+inline __m128 simd_pick<min_op>(__m128 acc, __m128 x) { return _mm_min_ps(x, acc); }
+template<>
+inline __m128 simd_pick<max_op>(__m128 acc, __m128 x) { return _mm_max_ps(x, acc); }
+
+template<typename Op>
+class word_reducer<double, Op> {
+public:
+    explicit word_reducer(double identity) : identity_(_mm_set1_pd(identity)) {
+        for(__m128d & a : acc_)
+            a = identity_;
+    }
+
+    void add(const double* v, std::uint64_t bits) {
+        alignas(16) static const std::uint64_t masks[4][2] = {
+            {0, 0}, {~0ull, 0}, {0, ~0ull}, {~0ull, ~0ull}};
+        for(std::size_t j = 0; j < 64; j += 8) {
+            for(std::size_t l = 0; l < 4; ++l, bits >>= 2) {
+                __m128d m = _mm_load_pd(reinterpret_cast<const double*>(masks[bits & 3]));
+                __m128d x = _mm_or_pd(_mm_and_pd(m, _mm_loadu_pd(v + j + 2 * l)), _mm_andnot_pd(m, identity_));
+                acc_[l] = simd_pick<Op>(acc_[l], x);
+            }
+        }
+    }
+
+    double result() const {
+        alignas(16) double lanes[8];
+        for(std::size_t l = 0; l < 4; ++l)
+            _mm_store_pd(lanes + 2 * l, acc_[l]);
+        double r = lanes[0];
+        for(std::size_t l = 1; l < 8; ++l)
+            r = Op::pick(r, lanes[l]);
+        return r;
+    }
+
+private:
+    __m128d identity_;
+    __m128d acc_[4];
+};
+
+template<typename Op>
+class word_reducer<float, Op> {
+public:
+    explicit word_reducer(float identity) : identity_(_mm_set1_ps(identity)) {
+        for(__m128 & a : acc_)
+            a = identity_;
+    }
+
+    void add(const float* v, std::uint64_t bits) {
+        alignas(16) static const std::uint32_t masks[16][4] = {
+            {0, 0, 0, 0}, {~0u, 0, 0, 0}, {0, ~0u, 0, 0}, {~0u, ~0u, 0, 0},
+            {0, 0, ~0u, 0}, {~0u, 0, ~0u, 0}, {0, ~0u, ~0u, 0}, {~0u, ~0u, ~0u, 0},
+            {0, 0, 0, ~0u}, {~0u, 0, 0, ~0u}, {0, ~0u, 0, ~0u}, {~0u, ~0u, 0, ~0u},
+            {0, 0, ~0u, ~0u}, {~0u, 0, ~0u, ~0u}, {0, ~0u, ~0u, ~0u}, {~0u, ~0u, ~0u, ~0u}};
+        for(std::size_t j = 0; j < 64; j += 8) {
+            for(std::size_t l = 0; l < 2; ++l, bits >>= 4) {
+                __m128 m = _mm_load_ps(reinterpret_cast<const float*>(masks[bits & 15]));
+                __m128 x = _mm_or_ps(_mm_and_ps(m, _mm_loadu_ps(v + j + 4 * l)), _mm_andnot_ps(m, identity_));
+                acc_[l] = simd_pick<Op>(acc_[l], x);
+            }
+        }
+    }
+
+    float result() const {
+        alignas(16) float lanes[8];
+        for(std::size_t l = 0; l < 2; ++l)
+            _mm_store_ps(lanes + 4 * l, acc_[l]);
+        float r = lanes[0];
+        for(std::size_t l = 1; l < 8; ++l)
+            r = Op::pick(r, lanes[l]);
+        return r;
+    }
+
+private:
+    __m128 identity_;
+    __m128 acc_[2];
+};
+#endif
+
+}
+
+// A column of nullable numbers, stored Arrow-style: the values contiguously,
+// and a packed validity bitmap with bit i (LSB first) set when row i holds a
+// value. Missing rows always hold T(), so kernels that do not care about
+// validity (sum) can run over the values alone.
+//
+// The kernels process the column in lanes of independent accumulators;
+// sums of floating point values are therefore added in a different order
+// than a plain left-to-right loop would use.
+template<typename T>
+class OptionalColumn {
+public:
+    static_assert(std::is_arithmetic<T>::value, "OptionalColumn holds arithmetic types");
+
+    OptionalColumn() : size_(0) {}
+
+    explicit OptionalColumn(const std::vector<optional<T>> & rows) : size_(0) {
+        reserve(rows.size());
+        for(const optional<T> & row : rows)
+            push_back(row);
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    void reserve(std::size_t n) {
+        values_.reserve(n);
+        validity_.reserve(words(n));
+    }
+
+    void push_back(T value) {
+        grow();
+        values_.push_back(value);
+        validity_.back() |= bit(size_);
+        ++size_;
+    }
+
+    void push_back(const optional<T> & row) {
+        if(row.hasValue())
+            push_back(row.getValue());
+        else
+            pushMissing();
+    }
+
+    void pushMissing() {
+        grow();
+        values_.push_back(T());
+        ++size_;
+    }
+
+    bool isValid(std::size_t i) const {
+        return (validity_[i / 64] & bit(i)) != 0;
+    }
+
+    optional<T> get(std::size_t i) const {
+        return isValid(i) ? optional<T>(values_[i]) : optional<T>();
+    }
+
+    void set(std::size_t i, const optional<T> & row) {
+        if(row.hasValue()) {
+            values_[i] = row.getValue();
+            validity_[i / 64] |= bit(i);
+        } else {
+            values_[i] = T();
+            validity_[i / 64] &= ~bit(i);
+        }
+    }
+
+    std::vector<optional<T>> toOptionals() const {
+        std::vector<optional<T>> out;
+        out.reserve(size_);
+        for(std::size_t i = 0; i < size_; ++i)
+            out.push_back(get(i));
+        return out;
+    }
+
+    // Raw access for further kernels: values() has T() in missing rows,
+    // validity() has one bit per row and zero bits past size().
+    const T* values() const {
+        return values_.data();
+    }
+
+    const std::uint64_t* validity() const {
+        return validity_.data();
+    }
+
+    std::size_t countValid() const {
+        std::uint64_t n = 0;
+        for(std::uint64_t w : validity_)
+            n += column_detail::popcount(w);
+        return static_cast<std::size_t>(n);
+    }
+
+    // Sum of the present values; T() if there are none.
+    T sum() const {
+        T acc[column_detail::lanes] = {};
+        const T* v = values_.data();
+        std::size_t i = 0;
+        for(; i + column_detail::lanes <= size_; i += column_detail::lanes) {
+            for(std::size_t l = 0; l < column_detail::lanes; ++l)
+                acc[l] += v[i + l];
+        }
+        T total = T();
+        for(std::size_t l = 0; l < column_detail::lanes; ++l)
+            total += acc[l];
+        for(; i < size_; ++i)
+            total += v[i];
+        return total;
+    }
+
+    // Empty when no row holds a value.
+    optional<T> min() const {
+        return reduce(std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                           : std::numeric_limits<T>::max(),
+                      column_detail::min_op());
+    }
+
+    optional<T> max() const {
+        return reduce(std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                           : std::numeric_limits<T>::lowest(),
+                      column_detail::max_op());
+    }
+
+    // The present values satisfying pred, as a column with no missing rows.
+    // pred is evaluated for every row, missing ones included (on T()).
+    template<typename FN>
+    OptionalColumn<T> filter(FN pred) const {
+        OptionalColumn<T> out;
+        out.values_.resize(size_);
+        std::size_t kept = 0;
+        const T* v = values_.data();
+        T* dest = out.values_.data();
+        // Branch-free compaction: every row is written, only kept rows
+        // advance the output position, so the selectivity of pred does not
+        // cost branch mispredictions.
+        for(std::size_t w = 0; w < validity_.size(); ++w) {
+            std::uint64_t bits = validity_[w];
+            const T* row = v + w * 64;
+            std::size_t n = rowsIn(w);
+            for(std::size_t j = 0; j < n; ++j, bits >>= 1) {
+                T x = row[j];
+                dest[kept] = x;
+                kept += static_cast<std::size_t>(bits & static_cast<std::uint64_t>(pred(x)) & 1);
+            }
+        }
+        out.values_.resize(kept);
+        out.size_ = kept;
+        out.validity_.assign(words(kept), ~std::uint64_t(0));
+        out.clearTail();
+        return out;
+    }
+
+    // Replaces every missing row with value; afterwards all rows are valid.
+    void fillMissing(T value) {
+        T* v = values_.data();
+        for(std::size_t w = 0; w < validity_.size(); ++w) {
+            std::uint64_t bits = validity_[w];
+            std::size_t base = w * 64;
+            std::size_t n = rowsIn(w);
+            if(bits == fullWord(n))
+                continue;
+            if(bits == 0) {
+                std::fill(v + base, v + base + n, value);
+            } else {
+                for(std::uint64_t missing = ~bits & fullWord(n); missing; missing &= missing - 1)
+                    v[base + column_detail::lowest_bit(missing)] = value;
+            }
+            validity_[w] = fullWord(n);
+        }
+    }
+
+private:
+    static std::size_t words(std::size_t n) {
+        return (n + 63) / 64;
+    }
+
+    static std::uint64_t bit(std::size_t i) {
+        return std::uint64_t(1) << (i % 64);
+    }
+
+    // Rows covered by bitmap word w, and the bits they occupy.
+    std::size_t rowsIn(std::size_t w) const {
+        return std::min<std::size_t>(64, size_ - w * 64);
+    }
+
+    static std::uint64_t fullWord(std::size_t rows) {
+        return rows == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << rows) - 1;
+    }
+
+    void grow() {
+        if(size_ % 64 == 0)
+            validity_.push_back(0);
+    }
+
+    void clearTail() {
+        if(size_ % 64)
+            validity_.back() &= bit(size_) - 1;
+    }
+
+    // Full words go through the lane reducer; the partial last word walks
+    // its set bits.
+    template<typename Op>
+    optional<T> reduce(T identity, Op) const {
+        if(countValid() == 0)
+            return optional<T>();
+        column_detail::word_reducer<T, Op> lanes(identity);
+        T tail = identity;
+        const T* v = values_.data();
+        for(std::size_t w = 0; w < validity_.size(); ++w) {
+            std::uint64_t bits = validity_[w];
+            std::size_t base = w * 64;
+            if(rowsIn(w) == 64) {
+                lanes.add(v + base, bits);
+            } else {
+                for(; bits; bits &= bits - 1)
+                    tail = Op::pick(tail, v[base + column_detail::lowest_bit(bits)]);
+            }
+        }
+        return optional<T>(Op::pick(lanes.result(), tail));
+    }
+
+    std::vector<T> values_;
+    std::vector<std::uint64_t> validity_;
+    std::size_t size_;
+};
+
+}
@@ -1,115 +1,892 @@
 #pragma once
 
 #include "cxxutils/cxx14shims.hpp"
+#include "cxxutils/failure_handler.hpp"
+#include "cxxutils/object_pool.hpp"
+#include "cxxutils/result_backtrace.hpp"
+#include "cxxutils/result_metrics.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <new>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include <type_traits>
+#include <utility>
 #include <assert.h>
 
 #include "optional.hpp"
 
+namespace result_detail {
+
+struct component_entry {
+    std::string name;
+    std::size_t id;
+};
+
+// Component names are interned once and never freed, so a component can be
+// referred to by a plain pointer for the lifetime of the program. Ids are
+// dense, in interning order.
+inline const component_entry* intern_component_locked(const std::string & name) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::unique_ptr<component_entry>> table;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<component_entry> & entry = table[name];
+    if(!entry) {
+        entry.reset(new component_entry{name, table.size() - 1});
+        cxxutils::metrics_detail::record_component(entry->id, name);
+    }
+    return entry.get();
+}
+
+// Each thread remembers the names it has interned, so building failures
+// from strings only takes the registry lock the first time a thread sees a
+// name.
+inline const component_entry* intern_component(const std::string & name) {
+    static thread_local std::unordered_map<std::string, const component_entry*> seen;
+    auto it = seen.find(name);
+    if(it != seen.end())
+        return it->second;
+    const component_entry* entry = intern_component_locked(name);
+    seen.emplace(name, entry);
+    return entry;
+}
+
+// One frame of error context: where the failure passed through. Both
+// strings must have static storage duration.
+struct context_frame {
+    const char* component;
+    const char* message;
+};
+
+// Immutable, reference counted error payload. The message text is stored in
+// the same allocation, directly after the header, followed by the sampled
+// backtrace if one was captured. Payloads may come from any allocator;
+// dispose knows how to give the block back to it.
+//
+// Context frames live in a small inline array. A payload is only written to
+// while its single owner holds it, so sharing stays immutable; once the
+// array is full or the payload is shared, a context-only payload pointing at
+// the previous one (parent) is added instead.
+struct error_payload {
+    static constexpr std::size_t inlineFrames = 4;
+
+    std::atomic<long> refs;
+    void (*dispose)(error_payload*);
+    const component_entry* component;
+    std::size_t length;
+    std::size_t traceDepth;
+    error_payload* parent;
+    std::size_t frameCount;
+    context_frame frames[inlineFrames];
+
+    const char* text() const {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+
+    void* const* trace() const {
+        return reinterpret_cast<void* const*>(reinterpret_cast<const char*>(this) + traceOffset(length));
+    }
+
+    static error_payload* create(const component_entry* component, const char* mesg, std::size_t length,
+                                 void* const* frames = nullptr, std::size_t depth = 0) {
+        return create(std::allocator<char>(), component, mesg, length, frames, depth);
+    }
+
+    template<typename Alloc>
+    static error_payload* create(const Alloc & alloc, const component_entry* component, const char* mesg, std::size_t length,
+                                 void* const* frames = nullptr, std::size_t depth = 0) {
+        using Units = typename std::allocator_traits<Alloc>::template rebind_alloc<unit>;
+        using Traits = std::allocator_traits<Units>;
+        Units units(alloc);
+        unit* mem = Traits::allocate(units, blockUnits<Units>(length, depth));
+        error_payload* p = ::new (static_cast<void*>(mem)) error_payload{{1}, &disposeWith<Units>, component, length, depth, nullptr, 0, {}};
+        char* text = reinterpret_cast<char*>(p + 1);
+        std::memcpy(text, mesg, length);
+        text[length] = '\0';
+        if(depth)
+            std::memcpy(reinterpret_cast<char*>(p) + traceOffset(length), frames, depth * sizeof(void*));
+        storeAllocator(units, mem, length, depth, std::integral_constant<bool, storesAllocator<Units>()>());
+        return p;
+    }
+
+    void retain() {
+        refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() {
+        error_payload* p = this;
+        while(p && p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            error_payload* parent = p->parent;
+            p->dispose(p);
+            p = parent;
+        }
+    }
+
+    const error_payload* root() const {
+        const error_payload* p = this;
+        while(p->parent)
+            p = p->parent;
+        return p;
+    }
+
+    // Returns the payload to use after appending a frame; consumes the
+    // caller's reference to this one.
+    error_payload* withFrame(const char* frameComponent, const char* frameMessage) {
+        if(refs.load(std::memory_order_acquire) == 1 && frameCount < inlineFrames) {
+            frames[frameCount++] = context_frame{frameComponent, frameMessage};
+            return this;
+        }
+        error_payload* node = create(component, "", 0);
+        node->parent = this;
+        node->frames[0] = context_frame{frameComponent, frameMessage};
+        node->frameCount = 1;
+        return node;
+    }
+
+private:
+    using unit = typename std::aligned_storage<sizeof(std::max_align_t), alignof(std::max_align_t)>::type;
+
+    // Stateless allocators are recreated on release rather than stored.
+    template<typename Units>
+    static constexpr bool storesAllocator() {
+        return !(std::is_empty<Units>::value && std::is_default_constructible<Units>::value);
+    }
+
+    static std::size_t alignUp(std::size_t n, std::size_t align) {
+        return (n + align - 1) / align * align;
+    }
+
+    static std::size_t traceOffset(std::size_t length) {
+        return alignUp(sizeof(error_payload) + length + 1, alignof(void*));
+    }
+
+    static std::size_t contentBytes(std::size_t length, std::size_t depth) {
+        return depth ? traceOffset(length) + depth * sizeof(void*) : sizeof(error_payload) + length + 1;
+    }
+
+    template<typename Units>
+    static std::size_t allocatorOffset(std::size_t length, std::size_t depth) {
+        return alignUp(contentBytes(length, depth), alignof(Units));
+    }
+
+    template<typename Units>
+    static std::size_t blockUnits(std::size_t length, std::size_t depth) {
+        std::size_t bytes = storesAllocator<Units>()
+            ? allocatorOffset<Units>(length, depth) + sizeof(Units)
+            : contentBytes(length, depth);
+        return (bytes + sizeof(unit) - 1) / sizeof(unit);
+    }
+
+    template<typename Units>
+    static void storeAllocator(const Units & units, unit* mem, std::size_t length, std::size_t depth, std::true_type) {
+        ::new (static_cast<void*>(reinterpret_cast<char*>(mem) + allocatorOffset<Units>(length, depth))) Units(units);
+    }
+
+    template<typename Units>
+    static void storeAllocator(const Units &, unit*, std::size_t, std::size_t, std::false_type) {}
+
+    template<typename Units>
+    static void disposeWith(error_payload* p) {
+        std::size_t length = p->length;
+        std::size_t depth = p->traceDepth;
+        unit* mem = reinterpret_cast<unit*>(p);
+        p->~error_payload();
+        deallocate<Units>(mem, length, depth, std::integral_constant<bool, storesAllocator<Units>()>());
+    }
+
+    template<typename Units>
+    static void deallocate(unit* mem, std::size_t length, std::size_t depth, std::true_type) {
+        Units* stored = reinterpret_cast<Units*>(reinterpret_cast<char*>(mem) + allocatorOffset<Units>(length, depth));
+        Units units(std::move(*stored));
+        stored->~Units();
+        std::allocator_traits<Units>::deallocate(units, mem, blockUnits<Units>(length, depth));
+    }
+
+    template<typename Units>
+    static void deallocate(unit* mem, std::size_t length, std::size_t depth, std::false_type) {
+        Units units;
+        std::allocator_traits<Units>::deallocate(units, mem, blockUnits<Units>(length, depth));
+    }
+};
+
+}
+
+// Handle to an interned component name. Creating one performs the interning
+// lookup, so hot paths should create them once and reuse them.
+class ResultComponent {
+public:
+    explicit ResultComponent(const std::string & name) :
+        entry(result_detail::intern_component(name)) {}
+
+    const std::string& name() const {
+        return entry->name;
+    }
+
+    // Dense id assigned when the name was first interned.
+    std::size_t id() const {
+        return entry->id;
+    }
+
+    bool operator==(const ResultComponent & other) const { return entry == other.entry; }
+    bool operator!=(const ResultComponent & other) const { return entry != other.entry; }
+
+private:
+    friend class ResultException;
+    explicit ResultComponent(const result_detail::component_entry* entry_in) : entry(entry_in) {}
+    const result_detail::component_entry* entry;
+};
+
+// Runtime control of backtrace capture for new failures. Nothing is captured
+// until a sample rate is set; every component is enabled by default.
+class ResultBacktrace {
+public:
+    // Capture for one in every n failures on each thread; 0 turns capture off.
+    static void setSampleRate(std::uint32_t n) {
+        cxxutils::backtrace_detail::config().sampleEvery.store(n, std::memory_order_relaxed);
+    }
+
+    static std::uint32_t sampleRate() {
+        return cxxutils::backtrace_detail::config().sampleEvery.load(std::memory_order_relaxed);
+    }
+
+    static void setEnabled(const ResultComponent & component, bool enabled) {
+        cxxutils::backtrace_detail::set_component(component.id(), enabled);
+    }
+
+    static void setAllEnabled(bool enabled) {
+        for(std::atomic<std::uint64_t> & word : cxxutils::backtrace_detail::config().mask)
+            word.store(enabled ? ~0ull : 0, std::memory_order_relaxed);
+    }
+
+    static bool isEnabled(const ResultComponent & component) {
+        return cxxutils::backtrace_detail::component_enabled(component.id());
+    }
+};
+
+// Errors share a single immutable payload, so copying a ResultException (and
+// so propagating a failed Result) is a reference count increment. A null
+// payload stands for the default error, so default construction and moves
+// never touch a shared count.
 class ResultException {
 public:
-    std::string component;
-    std::string mesg;
+    ResultException() noexcept : payload(nullptr) {}
+
+    explicit ResultException(const ResultComponent & component_in, const std::string & mesg_in) :
+        payload(createPayload(std::allocator<char>(), component_in, mesg_in.data(), mesg_in.size())) {}
+
+    explicit ResultException(const ResultComponent & component_in, const char * mesg_in) :
+        payload(createPayload(std::allocator<char>(), component_in, mesg_in, std::strlen(mesg_in))) {}
+
+    explicit ResultException(const std::string & component_in, const std::string & mesg_in) :
+        ResultException(ResultComponent(component_in), mesg_in) {}
+
+    // Allocator-aware forms: the payload is allocated from alloc, e.g. a
+    // per-request cxxutils::ArenaAllocator.
+    template<typename Alloc>
+    ResultException(std::allocator_arg_t, const Alloc & alloc, const ResultComponent & component_in, const std::string & mesg_in) :
+        payload(createPayload(alloc, component_in, mesg_in.data(), mesg_in.size())) {}
+
+    template<typename Alloc>
+    ResultException(std::allocator_arg_t, const Alloc & alloc, const ResultComponent & component_in, const char * mesg_in) :
+        payload(createPayload(alloc, component_in, mesg_in, std::strlen(mesg_in))) {}
+
+    template<typename Alloc>
+    ResultException(std::allocator_arg_t, const Alloc & alloc, const std::string & component_in, const std::string & mesg_in) :
+        ResultException(std::allocator_arg, alloc, ResultComponent(component_in), mesg_in) {}
+
+    ResultException(const ResultException & orig) : payload(orig.payload) {
+        if(payload)
+            payload->retain();
+    }
+
+    // The moved-from exception is left as the default error, so it can
+    // still be copied and read.
+    ResultException( ResultException && orig) noexcept : payload(orig.payload) {
+        orig.payload = nullptr;
+    }
+
+    ResultException& operator=(const ResultException & orig) {
+        if(orig.payload)
+            orig.payload->retain();
+        if(payload)
+            payload->release();
+        payload = orig.payload;
+        return *this;
+    }
+
+    ResultException& operator=(ResultException && orig) noexcept {
+        std::swap(payload, orig.payload);
+        return *this;
+    }
+
+    ~ResultException() {
+        if(payload)
+            payload->release();
+    }
+
+    const std::string& component() const {
+        return root()->component->name;
+    }
+
+    ResultComponent componentHandle() const {
+        return ResultComponent(root()->component);
+    }
+
+    const char* mesg() const {
+        return root()->text();
+    }
+
+    std::size_t mesgLength() const {
+        return root()->length;
+    }
+
+    // Records that the failure passed through component. Both strings must
+    // be static; nothing is formatted until describe() is called.
+    ResultException& addContext(const char * component_in, const char * message_in) {
+        if(!payload) {
+            payload = defaultPayload();
+            payload->retain();
+        }
+        payload = payload->withFrame(component_in, message_in);
+        return *this;
+    }
+
+    // Context frames, innermost (first added) first.
+    std::vector<result_detail::context_frame> context() const {
+        std::vector<const result_detail::error_payload*> chain;
+        for(const result_detail::error_payload* p = payload; p; p = p->parent)
+            chain.push_back(p);
+        std::vector<result_detail::context_frame> frames;
+        for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+            frames.insert(frames.end(), (*it)->frames, (*it)->frames + (*it)->frameCount);
+        return frames;
+    }
+
+    // Return addresses captured when the failure was created, innermost
+    // first; empty unless the failure was sampled (see ResultBacktrace).
+    std::vector<void*> backtrace() const {
+        const result_detail::error_payload* r = root();
+        return std::vector<void*>(r->trace(), r->trace() + r->traceDepth);
+    }
+
+    // Renders the error, its context chain and any captured backtrace as
+    // text. Only here are backtrace addresses resolved to names.
+    std::string describe() const {
+        std::string out = component();
+        out += ": ";
+        out.append(mesg(), mesgLength());
+        for(const result_detail::context_frame & f : context()) {
+            out += "\n  in ";
+            out += f.component;
+            out += ": ";
+            out += f.message;
+        }
+        const result_detail::error_payload* r = root();
+        if(r->traceDepth) {
+            out += "\n  backtrace:";
+            for(std::size_t i = 0; i < r->traceDepth; ++i) {
+                out += "\n    #";
+                out += std::to_string(i);
+                out += ' ';
+                out += cxxutils::backtrace_detail::symbolize(r->trace()[i]);
+            }
+        }
+        return out;
+    }
+
+private:
+    // Every new failure goes through here: it is counted and, if sampled,
+    // gets a backtrace.
+    template<typename Alloc>
+    static result_detail::error_payload* createPayload(const Alloc & alloc, const ResultComponent & component_in,
+                                                       const char * mesg_in, std::size_t length) {
+        cxxutils::metrics_detail::record_created(component_in.id());
+        void* frames[cxxutils::backtrace_detail::maxDepth];
+        std::size_t depth = cxxutils::backtrace_detail::capture(component_in.id(), frames);
+        return result_detail::error_payload::create(alloc, component_in.entry, mesg_in, length, frames, depth);
+    }
+
+    const result_detail::error_payload* root() const {
+        return payload ? payload->root() : defaultPayload();
+    }
+
+    static result_detail::error_payload* defaultPayload() {
+        static result_detail::error_payload* p = result_detail::error_payload::create(
+            result_detail::intern_component("unknown component"), "Unknown exception", 17);
+        return p;
+    }
+
+    result_detail::error_payload* payload;
+};
+
+inline std::ostream& operator<<(std::ostream & os, const ResultException & e) {
+    return os << e.describe();
+}
+
+// Debug checking of how Results are used. With CXXUTILS_RESULT_TRACKING set
+// to 1 a Result remembers whether it
+// has been inspected (isOK, getValueOrThrow, or any combinator, all of which
+// check first), and reports
+//   - getValue/takeValue/getException/takeException before any inspection;
+//   - a failed Result destroyed or overwritten without being inspected.
+// Set it to 0 and the accessors carry no checks at all. Tracking only
+// applies to Results whose value or error is not trivially copyable (so
+// including every ResultException error); trivial Results stay trivially
+// copyable and usable in constant expressions, and keep the plain asserts.
+// Tracking changes the layout of Result, so it has to be defined the same
+// way for the whole program and NDEBUG has no say. The cxxutils CMake target
+// defines it, on in Debug configurations by default; without that it is off
+// unless defined.
+#ifndef CXXUTILS_RESULT_TRACKING
+#define CXXUTILS_RESULT_TRACKING 0
+#endif
+
+class ResultChecks {
+public:
+    using Handler = void (*)(const char * what);
+
+    // Installs the handler for tracking reports and returns the previous
+    // one. Passing nullptr restores the default, which prints what to stderr
+    // and aborts.
+    static Handler setHandler(Handler h) {
+        return handler().exchange(h ? h : &defaultHandler);
+    }
+
+    static void report(const char * what) {
+        handler().load(std::memory_order_acquire)(what);
+    }
+
+private:
+    static void defaultHandler(const char * what) {
+        std::fprintf(stderr, "cxxutils: %s\n", what);
+        std::fflush(stderr);
+        std::abort();
+    }
+
+    static std::atomic<Handler>& handler() {
+        static std::atomic<Handler> h{&defaultHandler};
+        return h;
+    }
+};
+
+namespace result_detail {
+
+// Inspection state for one Result. The disabled form is an empty base, so
+// it costs nothing.
+template<bool Enabled = CXXUTILS_RESULT_TRACKING != 0>
+class tracker {
+public:
+    constexpr explicit tracker(bool) {}
+    constexpr void inspect() const {}
+    constexpr void access() const {}
+};
+
+template<>
+class tracker<true> {
+public:
+    explicit tracker(bool failed) : failed_(failed), inspected_(false) {}
+
+    // A copy or move takes over the responsibility for checking the outcome,
+    // so the source is not reported when it is dropped.
+    tracker(const tracker & o) : failed_(o.failed_), inspected_(o.inspected_) {
+        o.inspected_ = true;
+    }
+
+    tracker(tracker && o) noexcept : failed_(o.failed_), inspected_(o.inspected_) {
+        o.inspected_ = true;
+    }
+
+    tracker& operator=(const tracker & o) {
+        if(this != &o) {
+            checkDropped();
+            failed_ = o.failed_;
+            inspected_ = o.inspected_;
+            o.inspected_ = true;
+        }
+        return *this;
+    }
+
+    tracker& operator=(tracker && o) noexcept {
+        if(this != &o) {
+            checkDropped();
+            failed_ = o.failed_;
+            inspected_ = o.inspected_;
+            o.inspected_ = true;
+        }
+        return *this;
+    }
 
-    ResultException() : component("unknown component"), mesg("Unknown exception")  {}
-    explicit ResultException(const std::string & component_in, const std::string & mesg_in) : component(component_in), mesg(mesg_in) {}
-    ResultException(const ResultException & orig) : component(orig.component), mesg(orig.mesg) {}
-    ResultException( ResultException && orig) {
-        std::swap(component, orig.component);
-        std::swap(mesg, orig.mesg);
+    ~tracker() {
+        checkDropped();
     }
+
+    void inspect() const {
+        inspected_ = true;
+    }
+
+    void access() const {
+        if(!inspected_)
+            ResultChecks::report("Result accessed without checking isOK()");
+    }
+
+private:
+    void checkDropped() const {
+        if(failed_ && !inspected_)
+            ResultChecks::report("failed Result dropped without being checked");
+    }
+
+    bool failed_;
+    mutable bool inspected_;
 };
 
+struct ok_tag {};
+struct failed_tag {};
+
 template<typename T>
+struct is_trivial_payload
+    : std::integral_constant<bool,
+          std::is_trivially_copyable<T>::value &&
+          std::is_trivially_destructible<T>::value> {};
+
+// Tagged union holding either a value or an error. There is no state with
+// both or neither, so accessors only need to look at the tag.
+template<typename T, typename E,
+         bool Trivial = is_trivial_payload<T>::value && is_trivial_payload<E>::value>
+struct storage : tracker<false> {
+    union {
+        T value_;
+        E error_;
+    };
+    bool ok_;
+
+    template<typename... Args>
+    constexpr explicit storage(ok_tag, Args&&... args) :
+        tracker<false>(false), value_(std::forward<Args>(args)...), ok_(true) {}
+
+    template<typename... Args>
+    constexpr explicit storage(failed_tag, Args&&... args) :
+        tracker<false>(true), error_(std::forward<Args>(args)...), ok_(false) {}
+};
+
+template<typename T, typename E>
+struct storage<T, E, false> : tracker<> {
+    union {
+        T value_;
+        E error_;
+    };
+    bool ok_;
+
+    template<typename... Args>
+    explicit storage(ok_tag, Args&&... args) :
+        tracker<>(false), value_(std::forward<Args>(args)...), ok_(true) {}
+
+    template<typename... Args>
+    explicit storage(failed_tag, Args&&... args) :
+        tracker<>(true), error_(std::forward<Args>(args)...), ok_(false) {}
+
+    storage(const storage& o) : tracker<>(o), ok_(o.ok_) {
+        if(ok_)
+            ::new (static_cast<void*>(std::addressof(value_))) T(o.value_);
+        else
+            ::new (static_cast<void*>(std::addressof(error_))) E(o.error_);
+    }
+
+    storage(storage&& o) noexcept(std::is_nothrow_move_constructible<T>::value &&
+                                 std::is_nothrow_move_constructible<E>::value) :
+        tracker<>(std::move(o)), ok_(o.ok_) {
+        if(ok_)
+            ::new (static_cast<void*>(std::addressof(value_))) T(std::move(o.value_));
+        else
+            ::new (static_cast<void*>(std::addressof(error_))) E(std::move(o.error_));
+    }
+
+    storage& operator=(const storage& o) {
+        if(this == &o)
+            return *this;
+        if(ok_ && o.ok_) {
+            value_ = o.value_;
+        } else if(!ok_ && !o.ok_) {
+            error_ = o.error_;
+        } else if(o.ok_) {
+            replace(error_, value_, o.value_);
+            ok_ = true;
+        } else {
+            replace(value_, error_, o.error_);
+            ok_ = false;
+        }
+        tracker<>::operator=(o);
+        return *this;
+    }
+
+    storage& operator=(storage&& o) {
+        if(ok_ && o.ok_) {
+            value_ = std::move(o.value_);
+        } else if(!ok_ && !o.ok_) {
+            error_ = std::move(o.error_);
+        } else if(o.ok_) {
+            replace(error_, value_, std::move(o.value_));
+            ok_ = true;
+        } else {
+            replace(value_, error_, std::move(o.error_));
+            ok_ = false;
+        }
+        tracker<>::operator=(std::move(o));
+        return *this;
+    }
+
+    ~storage() {
+        destroy();
+    }
+
+private:
+    void destroy() {
+        if(ok_)
+            value_.~T();
+        else
+            error_.~E();
+    }
+
+    // Swaps the alternative held in from for a New built from arg. As in
+    // std::expected, a constructor that throws leaves the old alternative in
+    // place: New is built aside first when it cannot be built in place
+    // without throwing, and if it cannot be moved without throwing either,
+    // the old alternative is moved aside and put back on failure.
+    template<typename Old, typename New, typename Arg>
+    static void replace(Old & from, New & to, Arg && arg) {
+        replace(from, to, std::forward<Arg>(arg),
+                std::integral_constant<int, std::is_nothrow_constructible<New, Arg&&>::value ? 0
+                                          : std::is_nothrow_move_constructible<New>::value ? 1 : 2>());
+    }
+
+    template<typename Old, typename New, typename Arg>
+    static void replace(Old & from, New & to, Arg && arg, std::integral_constant<int, 0>) {
+        from.~Old();
+        ::new (static_cast<void*>(std::addressof(to))) New(std::forward<Arg>(arg));
+    }
+
+    template<typename Old, typename New, typename Arg>
+    static void replace(Old & from, New & to, Arg && arg, std::integral_constant<int, 1>) {
+        New tmp(std::forward<Arg>(arg));
+        from.~Old();
+        ::new (static_cast<void*>(std::addressof(to))) New(std::move(tmp));
+    }
+
+    template<typename Old, typename New, typename Arg>
+    static void replace(Old & from, New & to, Arg && arg, std::integral_constant<int, 2>) {
+        static_assert(std::is_nothrow_move_constructible<Old>::value,
+                      "Result assignment needs T or E to be nothrow move constructible");
+        Old saved(std::move(from));
+        from.~Old();
+#ifdef CXXUTILS_NO_EXCEPTIONS
+        ::new (static_cast<void*>(std::addressof(to))) New(std::forward<Arg>(arg));
+#else
+        try {
+            ::new (static_cast<void*>(std::addressof(to))) New(std::forward<Arg>(arg));
+        } catch(...) {
+            ::new (static_cast<void*>(std::addressof(from))) Old(std::move(saved));
+            throw;
+        }
+#endif
+    }
+};
+
+}
+
+template<typename T, typename E = ResultException>
+class Result;
+
+namespace result_detail {
+
+template<typename T, typename Alloc, typename... Args>
+T construct_with_allocator(const Alloc & alloc, std::true_type, Args&&... args) {
+    return T(std::forward<Args>(args)..., alloc);
+}
+
+template<typename T, typename Alloc, typename... Args>
+T construct_with_allocator(const Alloc &, std::false_type, Args&&... args) {
+    return T(std::forward<Args>(args)...);
+}
+
+}
+
+namespace result_detail {
+
+// Throws e, or in exception-free builds reports it through the cxxutils
+// failure handler.
+template<typename E>
+[[noreturn]] void raise(const E & e) {
+    (void)e;
+    CXXUTILS_THROW(e, "getValueOrThrow called on a failed Result");
+}
+
+#ifdef CXXUTILS_NO_EXCEPTIONS
+#if defined(__GNUC__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void raise(const ResultException & e) {
+    char what[256];
+    std::snprintf(what, sizeof(what), "getValueOrThrow called on a failed Result: %s: %s",
+                  e.component().c_str(), e.mesg());
+    cxxutils::failure_detail::fail(what);
+}
+#endif
+
+// Failure metrics are keyed by ResultException component; other error types
+// are not counted.
+template<typename E>
+constexpr void record_propagated(const E &) {}
+
+inline void record_propagated(const ResultException & e) {
+#ifdef CXXUTILS_RESULT_METRICS
+    cxxutils::metrics_detail::record_propagated(e.componentHandle().id());
+#else
+    (void)e;
+#endif
+}
+
+}
+
+// Hook used when a failure crosses from a Result with error type From to one
+// with error type To, e.g. in translateError or flatmap. The default uses
+// To's converting constructor; specialize it for other conversions.
+template<typename From, typename To>
+struct result_error_converter {
+    static constexpr To convert(const From & e) {
+        return To(e);
+    }
+};
+
+template<typename E>
+struct result_error_converter<E, E> {
+    static constexpr const E& convert(const E & e) {
+        return e;
+    }
+};
+
+template<typename T, typename E>
 class Result {
 
 private:
 
-    Result( optional<T> && value, optional<ResultException> && exception ) :
-        value(std::move(value)),
-        exception(std::move(exception)) {
+    using Storage = result_detail::storage<T, E>;
+
+    template<typename Tag, typename... Args>
+    constexpr explicit Result( Tag tag, Args&&... args ) :
+        storage(tag, std::forward<Args>(args)...) {
     }
 
-    optional<T> value;
-    optional<ResultException> exception;
+    Storage storage;
 
-public:
-    static Result<T> ok(const T & value) {
-        return Result<T>( optional<T>(value), optional<ResultException>() );
+    template<typename, typename> friend class Result;
+
+    // The error, for propagation; counts as inspecting this Result.
+    constexpr const E& error() const {
+        storage.inspect();
+        return storage.error_;
     }
 
-    static Result<T> ok(T && value) {
-        return Result<T>( optional<T>(std::move(value)), optional<ResultException>() );
+public:
+    using value_type = T;
+    using error_type = E;
+
+    CXXUTILS_NODISCARD static constexpr Result<T, E> ok(const T & value) {
+        return Result<T, E>( result_detail::ok_tag(), value );
     }
 
-    static Result<T> failed(const ResultException & e) {
-        return Result<T>( optional<T>(), optional<ResultException>(e) );
+    CXXUTILS_NODISCARD static constexpr Result<T, E> ok(T && value) {
+        return Result<T, E>( result_detail::ok_tag(), std::move(value) );
     }
 
-    static Result<T> failed(ResultException && e) {
-        return Result<T>( optional<T>(), optional<ResultException>( std::move(e) ) );
+    CXXUTILS_NODISCARD static constexpr Result<T, E> failed(const E & e) {
+        return Result<T, E>( result_detail::failed_tag(), e );
     }
 
-    void ensureValid() const {
-        bool hasValue = value.hasValue();
-        bool hasException = exception.hasValue();
+    CXXUTILS_NODISCARD static constexpr Result<T, E> failed(E && e) {
+        return Result<T, E>( result_detail::failed_tag(), std::move(e) );
+    }
 
-        if(hasValue && hasException)
-            throw std::runtime_error("Invalid Result: Result has both value and exception");
-        if(!hasValue && !hasException)
-            throw std::runtime_error("Invalid Result: Result has neither value or exception");
+    constexpr bool isOK() const {
+        storage.inspect();
+        return storage.ok_;
     }
 
+    constexpr const T& getValue() const {
+        storage.access();
+        assert(storage.ok_);
+        return storage.value_;
+    }
 
-    bool isOK() const {
-        ensureValid();
-        return value.hasValue();
+    constexpr const T& getValueOrThrow() const {
+        storage.inspect();
+        if(!storage.ok_)
+            result_detail::raise(storage.error_);
+        return storage.value_;
     }
 
-    const T& getValue() const {
-        ensureValid();
-        assert(value.hasValue());
-        return value.getValue();
+    std::unique_ptr<T> takeValuePtr() {
+        return cxx14::make_unique<T>(takeValue());
     }
 
-    const T& getValueOrThrow() const {
-        ensureValid();
-        if(!isOK())
-            throw exception.getValue();
-        return value.getValue();
+    constexpr T takeValue() {
+        storage.access();
+        assert(storage.ok_);
+        return std::move(storage.value_);
     }
 
-    std::unique_ptr<T>&& takeValuePtr() {
-        return std::move(value);
+    constexpr const E& getException() const {
+        storage.access();
+        assert(!storage.ok_);
+        return storage.error_;
     }
 
-    T&& takeValue() {
-        return value.takeValue();
+    // Moves the error out; the Result must have failed.
+    constexpr E takeException() {
+        storage.access();
+        assert(!storage.ok_);
+        return std::move(storage.error_);
     }
 
-    const ResultException& getException() const {
-        ensureValid();
-        return exception.getValue();
+    template<typename U, typename F>
+    static constexpr Result<T, E> translateError(const Result<U, F> & u) {
+        result_detail::record_propagated(u.error());
+        return Result<T, E>::failed(result_error_converter<F, E>::convert(u.error()));
     }
 
     template<typename U>
-    static Result<T> translateError(const Result<U> & u) {
-        return Result<T>::failed(u.getException());
+    static constexpr Result<T, E> translateError(Result<U, E> && u) {
+        result_detail::record_propagated(u.error());
+        return Result<T, E>::failed(u.takeException());
     }
 
 
    template<typename FN>
-   auto map(FN f) -> Result<decltype(f(getValue()))> {
-      using RESULT = Result<decltype(f(getValue()))>;
+   constexpr auto map(FN f) const & -> Result<decltype(f(std::declval<const T&>())), E> {
+      using RESULT = Result<decltype(f(std::declval<const T&>())), E>;
       if(isOK()) {
         return RESULT::ok(f(getValue()));
       }
       return RESULT::translateError( *this );
     }
 
+   // On an rvalue the value is moved into f, and the error moved on.
+   template<typename FN>
+   constexpr auto map(FN f) && -> Result<decltype(f(std::declval<T&&>())), E> {
+      using RESULT = Result<decltype(f(std::declval<T&&>())), E>;
+      if(isOK()) {
+        return RESULT::ok(f(std::move(storage.value_)));
+      }
+      return RESULT::translateError( std::move(*this) );
+    }
+
     template<typename FN>
-    auto take_map(FN f) -> Result<decltype(f(takeValue()))> {
-        using RESULT = Result<decltype(f(takeValue()))>;
+    auto take_map(FN f) -> Result<decltype(f(takeValue())), E> {
+        using RESULT = Result<decltype(f(takeValue())), E>;
         if(isOK()) {
             return RESULT::ok(f(takeValue()));
         }
@@ -117,66 +894,158 @@ public:
     }
 
     template<typename FN>
-    auto take_map_void(FN f) -> Result<void>;
+    auto take_map_void(FN f) -> Result<void, E>;
 
    template<typename FN>
-   auto flatmap(FN f) -> decltype(f(getValue())) {
+   constexpr auto flatmap(FN f) const & -> decltype(f(std::declval<const T&>())) {
        if(isOK()) {
          return f(getValue());
        }
-       return decltype(f(getValue()))::translateError( *this );
+       return decltype(f(std::declval<const T&>()))::translateError( *this );
+     }
+
+   template<typename FN>
+   constexpr auto flatmap(FN f) && -> decltype(f(std::declval<T&&>())) {
+       if(isOK()) {
+         return f(std::move(storage.value_));
+       }
+       return decltype(f(std::declval<T&&>()))::translateError( std::move(*this) );
+     }
+
+   template<typename FN>
+   constexpr auto and_then(FN f) const & -> decltype(f(std::declval<const T&>())) {
+       return flatmap(std::move(f));
+     }
+
+   template<typename FN>
+   constexpr auto and_then(FN f) && -> decltype(f(std::declval<T&&>())) {
+       return std::move(*this).flatmap(std::move(f));
+     }
+
+   // Recovers from a failure: f maps the error to a new Result<T, E>. An OK
+   // result is passed through unchanged.
+   template<typename FN>
+   constexpr Result<T, E> or_else(FN f) const & {
+       if(isOK()) {
+         return *this;
+       }
+       return f(getException());
      }
 
    template<typename FN>
-   void on_failure(FN f) {
+   constexpr Result<T, E> or_else(FN f) && {
+       if(isOK()) {
+         return std::move(*this);
+       }
+       return f(takeException());
+     }
+
+   template<typename FN>
+   constexpr auto mapError(FN f) -> Result<T, decltype(f(getException()))> {
+       using RESULT = Result<T, decltype(f(getException()))>;
+       if(isOK()) {
+         return RESULT::ok(getValue());
+       }
+       return RESULT::failed(f(getException()));
+     }
+
+   template<typename FN>
+   constexpr void on_failure(FN f) const {
        if(!isOK()) {
          f(getException());
        }
    }
 
+   // Appends a context frame to a failure; does nothing on success. Both
+   // strings must be static.
+   Result<T, E>& add_context(const char * component, const char * message) {
+       if(!storage.ok_) {
+         storage.error_.addContext(component, message);
+       }
+       return *this;
+   }
+
+   Result<T, E> with_context(const char * component, const char * message) const & {
+       Result<T, E> copy(*this);
+       copy.add_context(component, message);
+       return copy;
+   }
+
+   Result<T, E> with_context(const char * component, const char * message) && {
+       add_context(component, message);
+       return std::move(*this);
+   }
+
 };
 
-template<>
-class Result<void> {
+template<typename E>
+class Result<void, E> : private result_detail::tracker<CXXUTILS_RESULT_TRACKING != 0 && !result_detail::is_trivial_payload<E>::value> {
 
 private:
+    using Tracker = result_detail::tracker<CXXUTILS_RESULT_TRACKING != 0 && !result_detail::is_trivial_payload<E>::value>;
 
-    explicit Result( optional<ResultException> && exception ) :
-        exception(std::move(exception)) {
+    constexpr explicit Result( optional<E> && exception ) :
+        Tracker(exception.hasValue()), exception(std::move(exception)) {
     }
 
-    optional<ResultException> exception;
+    optional<E> exception;
+
+    template<typename, typename> friend class Result;
+
+    constexpr const E& error() const {
+        this->inspect();
+        return exception.getValue();
+    }
 
 
 public:
-    static Result<void> ok() {
-        return Result<void>( optional<ResultException>() );
+    using value_type = void;
+    using error_type = E;
+
+    CXXUTILS_NODISCARD static constexpr Result<void, E> ok() {
+        return Result<void, E>( optional<E>() );
     }
 
-    static Result<void> failed(const ResultException & e) {
-        return Result<void>( optional<ResultException>(e) );
+    CXXUTILS_NODISCARD static constexpr Result<void, E> failed(const E & e) {
+        return Result<void, E>( optional<E>(e) );
     }
 
-    static Result<void> failed(ResultException && e) {
-        return Result<void>( optional<ResultException>(std::move(e)) );
+    CXXUTILS_NODISCARD static constexpr Result<void, E> failed(E && e) {
+        return Result<void, E>( optional<E>(std::move(e)) );
     }
 
-    bool isOK() const {
+    constexpr bool isOK() const {
+        this->inspect();
         return !exception.hasValue();
     }
 
-    const ResultException& getException() const {
+    constexpr const E& getException() const {
+        this->access();
         return exception.getValue();
     }
 
+    // Like Result<T, E>::takeException, the Result stays failed and is left
+    // holding a moved-from error.
+    constexpr E takeException() {
+        this->access();
+        return std::move(exception.getValue());
+    }
+
+    template<typename U, typename F>
+    static constexpr Result<void, E> translateError(const Result<U, F> & u) {
+        result_detail::record_propagated(u.error());
+        return Result<void, E>::failed(result_error_converter<F, E>::convert(u.error()));
+    }
+
     template<typename U>
-    static Result<void> translateError(const Result<U> & u) {
-        return Result<void>::failed(u.getException());
+    static constexpr Result<void, E> translateError(Result<U, E> && u) {
+        result_detail::record_propagated(u.error());
+        return Result<void, E>::failed(u.takeException());
     }
 
    template<typename FN>
-#define RESULT Result<decltype(f())>
-   auto map(FN f) -> RESULT {
+#define RESULT Result<decltype(f()), E>
+   constexpr auto map(FN f) const -> RESULT {
       if(isOK()) {
         return RESULT::ok(f());
       }
@@ -185,7 +1054,7 @@ public:
 #undef RESULT
 
    template<typename FN>
-   auto flatmap(FN f) -> decltype(f()) {
+   constexpr auto flatmap(FN f) const -> decltype(f()) {
        if(isOK()) {
          return f();
        }
@@ -193,46 +1062,111 @@ public:
      }
 
    template<typename FN>
-   void on_failure(FN f) {
+   constexpr auto and_then(FN f) const -> decltype(f()) {
+       return flatmap(std::move(f));
+     }
+
+   template<typename FN>
+   constexpr Result<void, E> or_else(FN f) const {
+       if(isOK()) {
+         return *this;
+       }
+       return f(getException());
+     }
+
+   template<typename FN>
+   constexpr auto mapError(FN f) -> Result<void, decltype(f(getException()))> {
+       using RESULT = Result<void, decltype(f(getException()))>;
+       if(isOK()) {
+         return RESULT::ok();
+       }
+       return RESULT::failed(f(getException()));
+     }
+
+   template<typename FN>
+   constexpr void on_failure(FN f) const {
        if(!isOK()) {
          f(getException());
        }
    }
 
+   Result<void, E>& add_context(const char * component, const char * message) {
+       if(exception.hasValue()) {
+         exception.getValue().addContext(component, message);
+       }
+       return *this;
+   }
+
+   Result<void, E> with_context(const char * component, const char * message) const & {
+       Result<void, E> copy(*this);
+       copy.add_context(component, message);
+       return copy;
+   }
+
+   Result<void, E> with_context(const char * component, const char * message) && {
+       add_context(component, message);
+       return std::move(*this);
+   }
+
 };
 
-template<typename T, typename... Args>
-Result<T> make_result_ok(Args&&... args) {
-  return Result<T>::ok( T(std::forward<Args>(args)... ));
+template<typename T, typename E = ResultException, typename... Args>
+CXXUTILS_NODISCARD Result<T, E> make_result_ok(Args&&... args) {
+  return Result<T, E>::ok( T(std::forward<Args>(args)... ));
 }
 
-template<typename T, typename... Args>
-Result<std::unique_ptr<T>> make_result_unique_ok(Args&&... args) {
-  return Result<std::unique_ptr<T>>::ok( cxx14::make_unique<T>(std::forward<Args>(args)... ));
+// Allocator-aware factories. The value is built with uses-allocator
+// construction when T supports it, and the error payload is allocated from
+// alloc.
+template<typename T, typename E = ResultException, typename Alloc, typename... Args>
+CXXUTILS_NODISCARD Result<T, E> make_result_ok(std::allocator_arg_t, Alloc && alloc, Args&&... args) {
+  return Result<T, E>::ok( result_detail::construct_with_allocator<T>(
+      alloc, std::uses_allocator<T, typename std::decay<Alloc>::type>(), std::forward<Args>(args)... ));
 }
 
-template<typename T, typename... Args>
-Result<std::shared_ptr<T>> make_result_shared_ok(Args&&... args) {
-  return Result<std::shared_ptr<T>>::ok( std::make_shared<T>(std::forward<Args>(args)... ));
+template<typename T, typename E = ResultException, typename Alloc, typename... Args>
+CXXUTILS_NODISCARD Result<T, E> make_result_failed(std::allocator_arg_t, Alloc && alloc, Args&&... args) {
+  return Result<T, E>::failed( E(std::allocator_arg, alloc, std::forward<Args>(args)... ));
 }
 
-template<typename T, typename... Args>
-Result<T> make_result_failed(Args&&... args) {
-  return Result<T>::failed( ResultException(std::forward<Args>(args)... ));
+template<typename T, typename E = ResultException, typename... Args>
+CXXUTILS_NODISCARD Result<std::unique_ptr<T>, E> make_result_unique_ok(Args&&... args) {
+  return Result<std::unique_ptr<T>, E>::ok( cxx14::make_unique<T>(std::forward<Args>(args)... ));
+}
+
+template<typename T, typename E = ResultException, typename... Args>
+CXXUTILS_NODISCARD Result<std::shared_ptr<T>, E> make_result_shared_ok(Args&&... args) {
+  return Result<std::shared_ptr<T>, E>::ok( std::make_shared<T>(std::forward<Args>(args)... ));
+}
+
+// Pooled variants: storage comes from cxxutils::ObjectPool<T>, and the
+// pool's hit/miss statistics cover both.
+template<typename T, typename E = ResultException, typename... Args>
+CXXUTILS_NODISCARD Result<cxxutils::pooled_unique_ptr<T>, E> make_result_pooled_unique_ok(Args&&... args) {
+  return Result<cxxutils::pooled_unique_ptr<T>, E>::ok( cxxutils::make_pooled_unique<T>(std::forward<Args>(args)... ));
+}
+
+template<typename T, typename E = ResultException, typename... Args>
+CXXUTILS_NODISCARD Result<std::shared_ptr<T>, E> make_result_pooled_shared_ok(Args&&... args) {
+  return Result<std::shared_ptr<T>, E>::ok( cxxutils::make_pooled_shared<T>(std::forward<Args>(args)... ));
+}
+
+template<typename T, typename E = ResultException, typename... Args>
+CXXUTILS_NODISCARD Result<T, E> make_result_failed(Args&&... args) {
+  return Result<T, E>::failed( E(std::forward<Args>(args)... ));
 }
 
 
 namespace ResultUtils {
 }
 
-template<typename T>
+template<typename T, typename E>
 template<typename FN>
-auto Result<T>::take_map_void(FN f) -> Result<void> {
-    using RESULT = Result<void>;
+auto Result<T, E>::take_map_void(FN f) -> Result<void, E> {
+    using RESULT = Result<void, E>;
     if(isOK()) {
         f(takeValue());
         return RESULT::ok();
     }
     return RESULT::translateError( *this );
 }
-
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/result.hpp"
+
+// Combines the errors of several failed Results into one. The default keeps
+// the first; ResultException joins all the messages.
+template<typename E>
+struct result_error_aggregator {
+    static E aggregate(std::vector<E> && errors) {
+        return std::move(errors.front());
+    }
+};
+
+template<>
+struct result_error_aggregator<ResultException> {
+    static ResultException aggregate(std::vector<ResultException> && errors) {
+        if(errors.size() == 1)
+            return std::move(errors.front());
+        std::ostringstream ss;
+        ss << errors.size() << " failures";
+        for(const ResultException & e : errors)
+            ss << "; " << e.component() << ": " << e.mesg();
+        static const ResultComponent component("aggregate");
+        return ResultException(component, ss.str());
+    }
+};
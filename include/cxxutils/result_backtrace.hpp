@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#if defined(__has_include)
+#if __has_include(<execinfo.h>) && __has_include(<dlfcn.h>) && __has_include(<cxxabi.h>)
+#define CXXUTILS_HAVE_BACKTRACE 1
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+#endif
+
+// Sampled backtrace capture for failure creation. Capturing is off until a
+// sample rate is set (see ResultBacktrace in result.hpp); the cost of a
+// failure that is not sampled is a relaxed load, a mask test and a
+// thread-local countdown. Sampled failures store up to
+// CXXUTILS_RESULT_BACKTRACE_DEPTH raw return addresses inline in the error
+// payload; they are only turned into names when the error is printed.
+
+#ifndef CXXUTILS_RESULT_BACKTRACE_DEPTH
+#define CXXUTILS_RESULT_BACKTRACE_DEPTH 16
+#endif
+
+namespace cxxutils {
+namespace backtrace_detail {
+
+constexpr std::size_t maxDepth = CXXUTILS_RESULT_BACKTRACE_DEPTH;
+
+// Component ids beyond the mask share its last bit.
+constexpr std::size_t maskBits = 256;
+
+struct settings {
+    std::atomic<std::uint32_t> sampleEvery;
+    std::atomic<std::uint64_t> mask[maskBits / 64];
+};
+
+// Constant initialized: every component enabled, sampling off.
+inline settings& config() {
+    static settings s{{0}, {{~0ull}, {~0ull}, {~0ull}, {~0ull}}};
+    return s;
+}
+
+inline std::size_t bit_for(std::size_t id) {
+    return id < maskBits ? id : maskBits - 1;
+}
+
+inline void set_component(std::size_t id, bool enabled) {
+    std::size_t bit = bit_for(id);
+    std::uint64_t flag = std::uint64_t(1) << (bit % 64);
+    if(enabled)
+        config().mask[bit / 64].fetch_or(flag, std::memory_order_relaxed);
+    else
+        config().mask[bit / 64].fetch_and(~flag, std::memory_order_relaxed);
+}
+
+inline bool component_enabled(std::size_t id) {
+    std::size_t bit = bit_for(id);
+    return (config().mask[bit / 64].load(std::memory_order_relaxed) >> (bit % 64)) & 1;
+}
+
+// Captures into frames if this failure is sampled and returns the number of
+// frames stored, not counting capture itself. Kept out of line so that frame
+// is always the one skipped.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+inline std::size_t capture(std::size_t componentId, void** frames) {
+    std::uint32_t every = config().sampleEvery.load(std::memory_order_relaxed);
+    if(every == 0 || !component_enabled(componentId))
+        return 0;
+    static thread_local std::uint32_t countdown = 0;
+    if(countdown == 0 || countdown > every)
+        countdown = every;
+    if(--countdown != 0)
+        return 0;
+#ifdef CXXUTILS_HAVE_BACKTRACE
+    void* raw[maxDepth + 1];
+    int n = ::backtrace(raw, static_cast<int>(maxDepth + 1));
+    std::size_t depth = n > 1 ? static_cast<std::size_t>(n - 1) : 0;
+    for(std::size_t i = 0; i < depth; ++i)
+        frames[i] = raw[i + 1];
+    return depth;
+#else
+    (void)frames;
+    return 0;
+#endif
+}
+
+// "function+0xoffset (module)" when the symbol is visible to the dynamic
+// linker (link with -rdynamic for executables), "module+0xoffset" otherwise,
+// which addr2line can resolve.
+inline std::string symbolize(const void* address) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%p", address);
+#ifdef CXXUTILS_HAVE_BACKTRACE
+    Dl_info info;
+    if(dladdr(address, &info) && info.dli_fname) {
+        std::string module = info.dli_fname;
+        std::size_t slash = module.rfind('/');
+        if(slash != std::string::npos)
+            module.erase(0, slash + 1);
+        const char* base = static_cast<const char*>(info.dli_sname ? info.dli_saddr : info.dli_fbase);
+        std::snprintf(buffer, sizeof(buffer), "+0x%zx",
+                      static_cast<std::size_t>(static_cast<const char*>(address) - base));
+        if(!info.dli_sname)
+            return module + buffer;
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string out = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+        return out + buffer + " (" + module + ")";
+    }
+#endif
+    return buffer;
+}
+
+}
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/result.hpp"
+
+namespace ResultUtils {
+
+namespace batch_detail {
+
+// collect hands back only the first failure; the Results after it count as
+// checked, so debug tracking does not report them as dropped. Without
+// tracking isOK() has no side effects and the loop compiles away.
+template<typename It>
+void mark_checked(It first, It last) {
+    for(; first != last; ++first)
+        (void)first->isOK();
+}
+
+// Reserves output space when the range can report its size.
+template<typename V, typename R>
+auto reserve_for(std::vector<V> & out, const R & range, int)
+    -> decltype(range.size(), void()) {
+    out.reserve(range.size());
+}
+
+template<typename V, typename R>
+void reserve_for(std::vector<V> &, const R &, long) {}
+
+template<typename FN, typename R>
+using result_of_element = decltype(std::declval<FN&>()(*std::begin(std::declval<R&>())));
+
+}
+
+// The outcome of running a fallible operation over a sequence. Successful
+// values are stored densely in input order, and failures go to a sparse
+// side-table keyed by input index, so a mostly-successful batch costs about
+// the same as a plain vector of values.
+template<typename T, typename E = ResultException>
+class ResultBatch {
+public:
+    struct Failure {
+        std::size_t index;
+        E error;
+    };
+
+    void reserve(std::size_t n) {
+        values_.reserve(n);
+    }
+
+    void push(Result<T, E> && r) {
+        if(r.isOK())
+            values_.push_back(r.takeValue());
+        else
+            failures_.push_back(Failure{size(), r.takeException()});
+    }
+
+    void push(const Result<T, E> & r) {
+        if(r.isOK())
+            values_.push_back(r.getValue());
+        else
+            failures_.push_back(Failure{size(), r.getException()});
+    }
+
+    std::size_t size() const {
+        return values_.size() + failures_.size();
+    }
+
+    std::size_t okCount() const {
+        return values_.size();
+    }
+
+    std::size_t failureCount() const {
+        return failures_.size();
+    }
+
+    bool allOK() const {
+        return failures_.empty();
+    }
+
+    // Values of the successful items, in input order.
+    const std::vector<T>& values() const {
+        return values_;
+    }
+
+    std::vector<T> takeValues() {
+        return std::move(values_);
+    }
+
+    // Failed items, ordered by input index.
+    const std::vector<Failure>& failures() const {
+        return failures_;
+    }
+
+    // All the values if every item succeeded, otherwise the first failure.
+    Result<std::vector<T>, E> toResult() && {
+        if(!failures_.empty())
+            return Result<std::vector<T>, E>::failed(std::move(failures_.front().error));
+        return Result<std::vector<T>, E>::ok(std::move(values_));
+    }
+
+private:
+    std::vector<T> values_;
+    std::vector<Failure> failures_;
+};
+
+// Turns a vector of Results into a Result of a vector, stopping at the first
+// failure. Values are moved out of the input.
+template<typename T, typename E>
+Result<std::vector<T>, E> collect(std::vector<Result<T, E>> && results) {
+    std::vector<T> values;
+    values.reserve(results.size());
+    for(auto it = results.begin(); it != results.end(); ++it) {
+        if(!it->isOK()) {
+            batch_detail::mark_checked(it + 1, results.end());
+            return Result<std::vector<T>, E>::translateError(std::move(*it));
+        }
+        values.push_back(it->takeValue());
+    }
+    return Result<std::vector<T>, E>::ok(std::move(values));
+}
+
+template<typename T, typename E>
+Result<std::vector<T>, E> collect(const std::vector<Result<T, E>> & results) {
+    std::vector<T> values;
+    values.reserve(results.size());
+    for(auto it = results.begin(); it != results.end(); ++it) {
+        if(!it->isOK()) {
+            batch_detail::mark_checked(it + 1, results.end());
+            return Result<std::vector<T>, E>::translateError(*it);
+        }
+        values.push_back(it->getValue());
+    }
+    return Result<std::vector<T>, E>::ok(std::move(values));
+}
+
+// Splits Results into the successful values and the errors, each in input
+// order.
+template<typename T, typename E>
+std::pair<std::vector<T>, std::vector<E>> partition(std::vector<Result<T, E>> && results) {
+    std::pair<std::vector<T>, std::vector<E>> out;
+    out.first.reserve(results.size());
+    for(Result<T, E> & r : results) {
+        if(r.isOK())
+            out.first.push_back(r.takeValue());
+        else
+            out.second.push_back(r.takeException());
+    }
+    return out;
+}
+
+// Applies a Result-returning fn to every element of range, stopping at the
+// first failure.
+template<typename R, typename FN>
+auto traverse(const R & range, FN fn)
+    -> Result<std::vector<typename batch_detail::result_of_element<FN, const R>::value_type>,
+              typename batch_detail::result_of_element<FN, const R>::error_type> {
+    using ELEMENT = batch_detail::result_of_element<FN, const R>;
+    using U = typename ELEMENT::value_type;
+    using RESULT = Result<std::vector<U>, typename ELEMENT::error_type>;
+    std::vector<U> values;
+    batch_detail::reserve_for(values, range, 0);
+    for(const auto & item : range) {
+        ELEMENT r = fn(item);
+        if(!r.isOK())
+            return RESULT::translateError(std::move(r));
+        values.push_back(r.takeValue());
+    }
+    return RESULT::ok(std::move(values));
+}
+
+// Applies a Result-returning fn to every element of range without stopping
+// at failures.
+template<typename R, typename FN>
+auto traverse_all(const R & range, FN fn)
+    -> ResultBatch<typename batch_detail::result_of_element<FN, const R>::value_type,
+                   typename batch_detail::result_of_element<FN, const R>::error_type> {
+    using ELEMENT = batch_detail::result_of_element<FN, const R>;
+    ResultBatch<typename ELEMENT::value_type, typename ELEMENT::error_type> batch;
+    for(const auto & item : range)
+        batch.push(fn(item));
+    return batch;
+}
+
+}
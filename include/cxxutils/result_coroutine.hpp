@@ -0,0 +1,251 @@
+#pragma once
+
+// Lets a function returning Result<T, E> be written as a C++20 coroutine:
+//
+//     Result<int> total(const Config & c) {
+//         int a = co_await parseInt(c.get("a"));
+//         int b = co_await parseInt(c.get("b"));
+//         co_return a + b;
+//     }
+//
+// co_await on a Result yields its value, or ends the coroutine and returns
+// the failure (converted via result_error_converter if the error types
+// differ). The coroutine never suspends, so it runs to completion before
+// returning. An exception thrown in the body is turned into a failure by
+// result_coroutine_exception.
+
+#if !defined(__cpp_impl_coroutine)
+#error "cxxutils/result_coroutine.hpp requires C++20 coroutine support"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#include "cxxutils/result.hpp"
+
+#ifndef CXXUTILS_NO_EXCEPTIONS
+// Hook used when an exception escapes the body of a Result coroutine; the
+// exception becomes the coroutine's failure. Error types constructible from
+// ResultException get what() under the "coroutine" component. For any other
+// error type the program is terminated, as if the body were noexcept;
+// specialize this to map exceptions onto such a type.
+template<typename E, typename = void>
+struct result_coroutine_exception {
+    [[noreturn]] static E convert(std::exception_ptr) {
+        std::terminate();
+    }
+};
+
+template<typename E>
+struct result_coroutine_exception<E, typename std::enable_if<std::is_constructible<E, const ResultException &>::value>::type> {
+    static E convert(std::exception_ptr p) {
+        static const ResultComponent component("coroutine");
+        try {
+            std::rethrow_exception(p);
+        } catch(const std::exception & e) {
+            return result_error_converter<ResultException, E>::convert(ResultException(component, e.what()));
+        } catch(...) {
+            return result_error_converter<ResultException, E>::convert(ResultException(component, "unknown exception"));
+        }
+    }
+};
+#endif
+
+namespace result_coroutine_detail {
+
+// Coroutine frames are recycled through a per-thread cache of size-bucketed
+// blocks, so a Result coroutine does not hit the global allocator in steady
+// state even when the compiler does not elide the frame allocation.
+class frame_cache {
+public:
+    static constexpr std::size_t granule = 64;
+    static constexpr std::size_t classes = 16;
+    static constexpr std::size_t maxCachedPerClass = 32;
+
+    static frame_cache& local() {
+        static thread_local frame_cache cache;
+        return cache;
+    }
+
+    void* allocate(std::size_t n) {
+        std::size_t c = sizeClass(n);
+        if(c >= classes)
+            return ::operator new(n);
+        if(node* p = heads[c]) {
+            heads[c] = p->next;
+            --counts[c];
+            return p;
+        }
+        return ::operator new((c + 1) * granule);
+    }
+
+    void deallocate(void* p, std::size_t n) {
+        std::size_t c = sizeClass(n);
+        if(c >= classes || counts[c] >= maxCachedPerClass) {
+            ::operator delete(p);
+            return;
+        }
+        node* block = static_cast<node*>(p);
+        block->next = heads[c];
+        heads[c] = block;
+        ++counts[c];
+    }
+
+    ~frame_cache() {
+        for(std::size_t c = 0; c < classes; ++c) {
+            while(node* p = heads[c]) {
+                heads[c] = p->next;
+                ::operator delete(p);
+            }
+        }
+    }
+
+private:
+    struct node {
+        node* next;
+    };
+
+    static std::size_t sizeClass(std::size_t n) {
+        return n == 0 ? 0 : (n - 1) / granule;
+    }
+
+    node* heads[classes] = {};
+    std::size_t counts[classes] = {};
+};
+
+template<typename T, typename E>
+struct return_object;
+
+template<typename T, typename E>
+struct promise_base {
+    return_object<T, E>* slot = nullptr;
+
+    static void* operator new(std::size_t n) {
+        return frame_cache::local().allocate(n);
+    }
+
+    static void operator delete(void* p, std::size_t n) {
+        frame_cache::local().deallocate(p, n);
+    }
+
+    return_object<T, E> get_return_object();
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+
+#ifdef CXXUTILS_NO_EXCEPTIONS
+    void unhandled_exception() { std::terminate(); }
+#else
+    // Rethrowing here would leave the frame alive at its final suspend
+    // point, so the exception becomes the coroutine's failure instead.
+    void unhandled_exception() {
+        slot->value.emplace(Result<T, E>::failed(result_coroutine_exception<E>::convert(std::current_exception())));
+    }
+#endif
+
+    void fail(E && e);
+
+    template<typename U, typename F, bool Move>
+    struct awaiter {
+        typename std::conditional<Move, Result<U, F>&&, const Result<U, F>&>::type r;
+
+        bool await_ready() const noexcept {
+            return r.isOK();
+        }
+
+        template<typename P>
+        void await_suspend(std::coroutine_handle<P> h) {
+            h.promise().fail(E(result_error_converter<F, E>::convert(r.getException())));
+            h.destroy();
+        }
+
+        decltype(auto) await_resume() {
+            if constexpr(std::is_void<U>::value) {
+                return;
+            } else if constexpr(Move) {
+                return r.takeValue();
+            } else {
+                return r.getValue();
+            }
+        }
+    };
+
+    template<typename U, typename F>
+    awaiter<U, F, true> await_transform(Result<U, F> && r) {
+        return awaiter<U, F, true>{std::move(r)};
+    }
+
+    template<typename U, typename F>
+    awaiter<U, F, false> await_transform(const Result<U, F> & r) {
+        return awaiter<U, F, false>{r};
+    }
+};
+
+// Object handed back by the coroutine ramp. The promise writes the outcome
+// into it, and it converts to the declared Result once the coroutine has
+// finished. This relies on the conversion to the return type happening when
+// the ramp returns, which GCC, Clang and MSVC all do when the types differ.
+template<typename T, typename E>
+struct return_object {
+    optional<Result<T, E>> value;
+    return_object<T, E>*& slot;
+
+    explicit return_object(return_object<T, E>*& slot_in) : slot(slot_in) {
+        slot = this;
+    }
+
+    return_object(return_object && o) : value(std::move(o.value)), slot(o.slot) {
+        slot = this;
+    }
+
+    operator Result<T, E>() {
+        return value.takeValue();
+    }
+};
+
+template<typename T, typename E>
+return_object<T, E> promise_base<T, E>::get_return_object() {
+    return return_object<T, E>(slot);
+}
+
+template<typename T, typename E>
+void promise_base<T, E>::fail(E && e) {
+    result_detail::record_propagated(e);
+    slot->value.emplace(Result<T, E>::failed(std::move(e)));
+}
+
+template<typename T, typename E>
+struct promise : promise_base<T, E> {
+    void return_value(const T & v) {
+        this->slot->value.emplace(Result<T, E>::ok(v));
+    }
+
+    void return_value(T && v) {
+        this->slot->value.emplace(Result<T, E>::ok(std::move(v)));
+    }
+
+    void return_value(Result<T, E> && r) {
+        this->slot->value.emplace(std::move(r));
+    }
+
+    void return_value(const Result<T, E> & r) {
+        this->slot->value.emplace(r);
+    }
+};
+
+template<typename E>
+struct promise<void, E> : promise_base<void, E> {
+    void return_void() {
+        this->slot->value.emplace(Result<void, E>::ok());
+    }
+};
+
+}
+
+template<typename T, typename E, typename... Args>
+struct std::coroutine_traits<Result<T, E>, Args...> {
+    using promise_type = result_coroutine_detail::promise<T, E>;
+};
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/async_result.hpp"
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_batch.hpp"
+
+// Deadlines and cancellation for chains of Results. The token-taking
+// overloads of ResultUtils::flatmap and ResultUtils::traverse check a
+// cxxutils::CancellationToken before each step and fail with a stop failure
+// (see result_stop_error) once it has been cancelled or its deadline has
+// passed. ResultUtils::hedged runs a backup attempt when the first is slower
+// than usual and keeps whichever succeeds first.
+
+namespace cxxutils {
+
+enum class StopReason { none, cancelled, deadline_exceeded };
+
+namespace cancel_detail {
+
+struct state {
+    std::atomic<bool> cancelled{false};
+    // Sources made from a token stop when their parent does.
+    std::shared_ptr<const state> parent;
+};
+
+}
+
+// What a chain of steps checks between steps: a cancellation flag, owned by
+// a CancellationSource, and an optional deadline. A default constructed
+// token never stops. Checking is an acquire load per linked source, plus a
+// clock read if the token has a deadline.
+class CancellationToken {
+public:
+    using clock = std::chrono::steady_clock;
+
+    CancellationToken() : deadline_(clock::time_point::max()) {}
+
+    // A token that never stops on its own but times out at deadline.
+    static CancellationToken until(clock::time_point deadline) {
+        return CancellationToken().withDeadline(deadline);
+    }
+
+    static CancellationToken after(clock::duration timeout) {
+        return until(clock::now() + timeout);
+    }
+
+    // This token, with its deadline moved earlier if deadline is earlier.
+    CancellationToken withDeadline(clock::time_point deadline) const {
+        CancellationToken t(*this);
+        t.deadline_ = std::min(deadline_, deadline);
+        return t;
+    }
+
+    CancellationToken withTimeout(clock::duration timeout) const {
+        return withDeadline(clock::now() + timeout);
+    }
+
+    clock::time_point deadline() const {
+        return deadline_;
+    }
+
+    StopReason stopReason() const {
+        for(const cancel_detail::state* s = state_.get(); s; s = s->parent.get()) {
+            if(s->cancelled.load(std::memory_order_acquire))
+                return StopReason::cancelled;
+        }
+        if(deadline_ != clock::time_point::max() && clock::now() >= deadline_)
+            return StopReason::deadline_exceeded;
+        return StopReason::none;
+    }
+
+    bool stopRequested() const {
+        return stopReason() != StopReason::none;
+    }
+
+private:
+    friend class CancellationSource;
+
+    std::shared_ptr<const cancel_detail::state> state_;
+    clock::time_point deadline_;
+};
+
+// Owns a cancellation flag. A source made from a token is cancelled along
+// with that token and its tokens keep the parent's deadline.
+class CancellationSource {
+public:
+    CancellationSource() :
+        state_(std::make_shared<cancel_detail::state>()), deadline_(CancellationToken::clock::time_point::max()) {}
+
+    explicit CancellationSource(const CancellationToken & parent) :
+        state_(std::make_shared<cancel_detail::state>()), deadline_(parent.deadline_) {
+        state_->parent = parent.state_;
+    }
+
+    void cancel() {
+        state_->cancelled.store(true, std::memory_order_release);
+    }
+
+    bool isCancelled() const {
+        return state_->cancelled.load(std::memory_order_acquire);
+    }
+
+    CancellationToken token() const {
+        CancellationToken t;
+        t.state_ = state_;
+        t.deadline_ = deadline_;
+        return t;
+    }
+
+private:
+    std::shared_ptr<cancel_detail::state> state_;
+    CancellationToken::clock::time_point deadline_;
+};
+
+// Components of the failures produced when a token stops a chain.
+inline const ResultComponent& cancelled_component() {
+    static const ResultComponent component("cancelled");
+    return component;
+}
+
+inline const ResultComponent& timeout_component() {
+    static const ResultComponent component("deadline");
+    return component;
+}
+
+inline bool is_cancelled(const ResultException & e) {
+    return e.componentHandle() == cancelled_component();
+}
+
+inline bool is_timeout(const ResultException & e) {
+    return e.componentHandle() == timeout_component();
+}
+
+// Latency histogram with four log-linear buckets per power of two of
+// nanoseconds, so percentiles are accurate to within 25%. Recording is a
+// relaxed increment and may happen from any thread.
+class LatencyTracker {
+public:
+    LatencyTracker() {
+        reset();
+    }
+
+    void record(std::chrono::nanoseconds latency) {
+        buckets_[bucketOf(latency.count())].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const {
+        std::uint64_t n = 0;
+        for(const std::atomic<std::uint64_t> & b : buckets_)
+            n += b.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Upper bound of the bucket holding quantile q (0 < q <= 1); zero when
+    // nothing has been recorded.
+    std::chrono::nanoseconds percentile(double q) const {
+        std::uint64_t total = count();
+        if(total == 0)
+            return std::chrono::nanoseconds(0);
+        std::uint64_t target = static_cast<std::uint64_t>(q * static_cast<double>(total));
+        target = std::max<std::uint64_t>(1, std::min(target, total));
+        std::uint64_t seen = 0;
+        for(std::size_t i = 0; i < bucketCount; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if(seen >= target)
+                return std::chrono::nanoseconds(upperBound(i));
+        }
+        return std::chrono::nanoseconds(upperBound(bucketCount - 1));
+    }
+
+    void reset() {
+        for(std::atomic<std::uint64_t> & b : buckets_)
+            b.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t bucketCount = 252;
+
+    static std::size_t bucketOf(std::int64_t nanos) {
+        std::uint64_t n = nanos > 0 ? static_cast<std::uint64_t>(nanos) : 0;
+        if(n < 4)
+            return static_cast<std::size_t>(n);
+        std::size_t octave = 0;
+        for(std::uint64_t v = n; v > 1; v >>= 1)
+            ++octave;
+        return std::min<std::size_t>(4 * (octave - 1) + ((n >> (octave - 2)) & 3), bucketCount - 1);
+    }
+
+    // Clamped to the largest duration for the top buckets, whose bound
+    // does not fit in 64 bits.
+    static std::int64_t upperBound(std::size_t bucket) {
+        const std::uint64_t most = static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+        if(bucket < 4)
+            return static_cast<std::int64_t>(bucket + 1);
+        std::size_t octave = bucket / 4 + 1;
+        if(octave - 2 > 60)
+            return static_cast<std::int64_t>(most);
+        std::uint64_t bound = (std::uint64_t(5) + bucket % 4) << (octave - 2);
+        return static_cast<std::int64_t>(std::min(bound, most));
+    }
+
+    std::atomic<std::uint64_t> buckets_[bucketCount];
+};
+
+struct HedgeOptions {
+    // A backup attempt starts once the outstanding ones have run for this
+    // latency quantile of earlier attempts.
+    double percentile = 0.95;
+    // Used instead while the tracker has fewer than minSamples samples.
+    std::chrono::nanoseconds initialDelay = std::chrono::milliseconds(10);
+    std::uint64_t minSamples = 32;
+    // Including the first.
+    std::size_t maxAttempts = 2;
+    // How often a waiting caller checks its token for cancellation.
+    std::chrono::nanoseconds pollInterval = std::chrono::milliseconds(1);
+};
+
+}
+
+// The failure a chain returns when its token stops it. The default
+// constructs E from the StopReason; ResultException uses the components
+// cxxutils::cancelled_component() and cxxutils::timeout_component().
+template<typename E>
+struct result_stop_error {
+    static E make(cxxutils::StopReason reason) {
+        return E(reason);
+    }
+};
+
+template<>
+struct result_stop_error<ResultException> {
+    static ResultException make(cxxutils::StopReason reason) {
+        if(reason == cxxutils::StopReason::cancelled)
+            return ResultException(cxxutils::cancelled_component(), "operation cancelled");
+        return ResultException(cxxutils::timeout_component(), "deadline exceeded");
+    }
+};
+
+namespace ResultUtils {
+
+// r.flatmap(f), except that f is not called once token has stopped; the
+// result is then the stop failure. Further steps are checked in turn:
+//
+//     Result<Reply> reply = ResultUtils::flatmap(parse(request), token, lookup, render);
+template<typename T, typename E, typename FN>
+auto flatmap(const Result<T, E> & r, const cxxutils::CancellationToken & token, FN f)
+    -> decltype(f(std::declval<const T&>())) {
+    using RET = decltype(f(std::declval<const T&>()));
+    if(!r.isOK())
+        return RET::translateError(r);
+    cxxutils::StopReason why = token.stopReason();
+    if(why != cxxutils::StopReason::none)
+        return RET::failed(result_stop_error<typename RET::error_type>::make(why));
+    return f(r.getValue());
+}
+
+template<typename T, typename E, typename FN>
+auto flatmap(Result<T, E> && r, const cxxutils::CancellationToken & token, FN f)
+    -> decltype(f(std::declval<T&&>())) {
+    using RET = decltype(f(std::declval<T&&>()));
+    if(!r.isOK())
+        return RET::translateError(r);
+    cxxutils::StopReason why = token.stopReason();
+    if(why != cxxutils::StopReason::none)
+        return RET::failed(result_stop_error<typename RET::error_type>::make(why));
+    return f(r.takeValue());
+}
+
+template<typename R, typename FN, typename NEXT, typename... REST>
+auto flatmap(R && r, const cxxutils::CancellationToken & token, FN f, NEXT next, REST... rest) {
+    return flatmap(flatmap(std::forward<R>(r), token, f), token, next, rest...);
+}
+
+// traverse, checking token before each element.
+template<typename R, typename FN>
+auto traverse(const R & range, const cxxutils::CancellationToken & token, FN fn)
+    -> Result<std::vector<typename batch_detail::result_of_element<FN, const R>::value_type>,
+              typename batch_detail::result_of_element<FN, const R>::error_type> {
+    using ELEMENT = batch_detail::result_of_element<FN, const R>;
+    using U = typename ELEMENT::value_type;
+    using RESULT = Result<std::vector<U>, typename ELEMENT::error_type>;
+    std::vector<U> values;
+    batch_detail::reserve_for(values, range, 0);
+    for(const auto & item : range) {
+        cxxutils::StopReason why = token.stopReason();
+        if(why != cxxutils::StopReason::none)
+            return RESULT::failed(result_stop_error<typename ELEMENT::error_type>::make(why));
+        ELEMENT r = fn(item);
+        if(!r.isOK())
+            return RESULT::translateError(r);
+        values.push_back(r.takeValue());
+    }
+    return RESULT::ok(std::move(values));
+}
+
+namespace hedge_detail {
+
+template<typename R>
+struct state {
+    using E = typename R::error_type;
+
+    state(const cxxutils::CancellationToken & token, std::size_t attempts) :
+        latencies(attempts, unfinished()), losers(token) {}
+
+    static std::chrono::nanoseconds unfinished() {
+        return std::chrono::nanoseconds(-1);
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    optional<R> winner;
+    // Of each attempt by launch order, once it has returned.
+    std::vector<std::chrono::nanoseconds> latencies;
+    std::vector<E> errors;
+    std::size_t finished = 0;
+    // Linked to the caller's token; cancelled once the call has an answer
+    // so outstanding attempts can give up.
+    cxxutils::CancellationSource losers;
+};
+
+}
+
+// Runs attempt(token) on ex and, if it has not succeeded within the
+// latency percentile recorded in latency, starts a backup attempt,
+// up to options.maxAttempts in all. An attempt that fails also starts the
+// next one straight away. Returns the first OK Result, or all the failures
+// combined by result_error_aggregator.
+//
+// The token passed to attempts is cancelled once the call returns, so slow
+// attempts can stop early; it also carries the caller's token's deadline and
+// cancellation. If the caller's token stops first, the stop failure is
+// returned. Every attempt launched is recorded in latency when the call
+// returns: the ones that have finished, won or lost, with their latency,
+// and the ones still running with the time they have run so far, a lower
+// bound. Recording only winners would bias the percentile towards the
+// fast attempts and hedge too early.
+template<typename FN, typename Executor>
+auto hedged(FN attempt, cxxutils::LatencyTracker & latency, Executor & ex,
+            const cxxutils::CancellationToken & token = cxxutils::CancellationToken(),
+            cxxutils::HedgeOptions options = cxxutils::HedgeOptions())
+    -> decltype(attempt(std::declval<const cxxutils::CancellationToken&>())) {
+    using R = decltype(attempt(std::declval<const cxxutils::CancellationToken&>()));
+    using E = typename R::error_type;
+    using clock = std::chrono::steady_clock;
+    using State = hedge_detail::state<R>;
+
+    options.maxAttempts = std::max<std::size_t>(options.maxAttempts, 1);
+    std::shared_ptr<State> st = std::make_shared<State>(token, options.maxAttempts);
+    cxxutils::CancellationToken attemptToken = st->losers.token();
+    std::chrono::nanoseconds delay = latency.count() >= options.minSamples
+        ? latency.percentile(options.percentile) : options.initialDelay;
+    std::size_t launched = 0;
+    std::vector<clock::time_point> starts;
+    starts.reserve(options.maxAttempts);
+
+    auto launch = [&] {
+        std::size_t index = launched++;
+        starts.push_back(clock::now());
+        ex.submit([st, attempt, attemptToken, index]() mutable {
+            clock::time_point start = clock::now();
+            R r = attempt(attemptToken);
+            std::lock_guard<std::mutex> lock(st->mutex);
+            st->latencies[index] = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+            if(r.isOK()) {
+                if(!st->winner.hasValue())
+                    st->winner.emplace(std::move(r));
+            } else {
+                st->errors.push_back(r.getException());
+            }
+            ++st->finished;
+            st->cv.notify_all();
+        });
+    };
+
+    // Called with the state's mutex held.
+    auto recordAttempts = [&] {
+        clock::time_point now = clock::now();
+        for(std::size_t i = 0; i < launched; ++i) {
+            std::chrono::nanoseconds l = st->latencies[i];
+            latency.record(l != State::unfinished() ? l : std::chrono::duration_cast<std::chrono::nanoseconds>(now - starts[i]));
+        }
+    };
+
+    launch();
+    std::unique_lock<std::mutex> lock(st->mutex);
+    while(!st->winner.hasValue()) {
+        cxxutils::StopReason why = token.stopReason();
+        if(why != cxxutils::StopReason::none) {
+            recordAttempts();
+            lock.unlock();
+            st->losers.cancel();
+            return R::failed(result_stop_error<E>::make(why));
+        }
+        bool allFailed = st->finished == launched;
+        if(allFailed && launched == options.maxAttempts)
+            break;
+        clock::time_point now = clock::now();
+        if(launched < options.maxAttempts && (allFailed || now >= starts.back() + delay)) {
+            lock.unlock();
+            launch();
+            lock.lock();
+            continue;
+        }
+        clock::time_point wake = now + options.pollInterval;
+        if(launched < options.maxAttempts)
+            wake = std::min(wake, starts.back() + delay);
+        wake = std::min(wake, token.deadline());
+        st->cv.wait_until(lock, wake);
+    }
+    recordAttempts();
+    st->losers.cancel();
+    if(st->winner.hasValue())
+        return st->winner.takeValue();
+    return R::failed(result_error_aggregator<E>::aggregate(std::move(st->errors)));
+}
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "cxxutils/result.hpp"
+
+namespace ResultUtils {
+
+// A lazily evaluated chain of map/flatmap steps over a Result. The steps are
+// composed into one function and run by run() (or by converting to the
+// Result type), so
+//
+//     lazy(std::move(r)).map(a).map(b).flatmap(c).run()
+//
+// evaluates c(b(a(value))) with the value moved through each step and no
+// intermediate Result objects. A map after a flatmap still has to look at
+// the Result the flatmap produced, but does so with the rvalue map, which
+// moves rather than copies.
+
+namespace lazy_detail {
+
+struct identity {
+    template<typename X>
+    X&& operator()(X && x) const {
+        return std::forward<X>(x);
+    }
+};
+
+template<typename X>
+struct is_result : std::false_type {};
+
+template<typename U, typename E>
+struct is_result<Result<U, E>> : std::true_type {};
+
+// Apply f to the output of g. If g already produces a Result, f is applied
+// inside it with Result's rvalue map / flatmap.
+template<typename G, typename F, bool GFlat, bool FFlat>
+struct compose;
+
+template<typename G, typename F>
+struct compose<G, F, false, false> {
+    G g; F f;
+    template<typename X>
+    auto operator()(X && x) -> decltype(f(g(std::forward<X>(x)))) {
+        return f(g(std::forward<X>(x)));
+    }
+};
+
+template<typename G, typename F>
+struct compose<G, F, false, true> {
+    G g; F f;
+    template<typename X>
+    auto operator()(X && x) -> decltype(f(g(std::forward<X>(x)))) {
+        return f(g(std::forward<X>(x)));
+    }
+};
+
+template<typename G, typename F>
+struct compose<G, F, true, false> {
+    G g; F f;
+    template<typename X>
+    auto operator()(X && x) -> decltype(g(std::forward<X>(x)).map(f)) {
+        return g(std::forward<X>(x)).map(f);
+    }
+};
+
+template<typename G, typename F>
+struct compose<G, F, true, true> {
+    G g; F f;
+    template<typename X>
+    auto operator()(X && x) -> decltype(g(std::forward<X>(x)).flatmap(f)) {
+        return g(std::forward<X>(x)).flatmap(f);
+    }
+};
+
+}
+
+template<typename T, typename E, typename G, bool Flat>
+class LazyResult {
+private:
+    using Out = decltype(std::declval<G&>()(std::declval<T&&>()));
+
+    template<typename, typename, typename, bool> friend class LazyResult;
+
+    template<typename X>
+    struct output {
+        using type = Result<typename std::decay<X>::type, E>;
+    };
+
+    template<typename U, typename F>
+    struct output<Result<U, F>> {
+        using type = Result<U, F>;
+    };
+
+public:
+    using result_type = typename output<typename std::decay<Out>::type>::type;
+
+    LazyResult(Result<T, E> && source_in, G g_in) :
+        source(std::move(source_in)), g(std::move(g_in)) {}
+
+    template<typename FN>
+    auto map(FN f) && -> LazyResult<T, E, lazy_detail::compose<G, FN, Flat, false>, Flat> {
+        return LazyResult<T, E, lazy_detail::compose<G, FN, Flat, false>, Flat>(
+            std::move(source), lazy_detail::compose<G, FN, Flat, false>{std::move(g), std::move(f)});
+    }
+
+    template<typename FN>
+    auto flatmap(FN f) && -> LazyResult<T, E, lazy_detail::compose<G, FN, Flat, true>, true> {
+        return LazyResult<T, E, lazy_detail::compose<G, FN, Flat, true>, true>(
+            std::move(source), lazy_detail::compose<G, FN, Flat, true>{std::move(g), std::move(f)});
+    }
+
+    result_type run() && {
+        if(!source.isOK())
+            return result_type::translateError(std::move(source));
+        return finish(g(source.takeValue()), std::integral_constant<bool, Flat>());
+    }
+
+    operator result_type() && {
+        return std::move(*this).run();
+    }
+
+private:
+    template<typename X>
+    static result_type finish(X && x, std::false_type) {
+        return result_type::ok(std::forward<X>(x));
+    }
+
+    template<typename X>
+    static result_type finish(X && x, std::true_type) {
+        return std::forward<X>(x);
+    }
+
+    Result<T, E> source;
+    G g;
+};
+
+template<typename T, typename E>
+LazyResult<T, E, lazy_detail::identity, false> lazy(Result<T, E> && r) {
+    return LazyResult<T, E, lazy_detail::identity, false>(std::move(r), lazy_detail::identity());
+}
+
+}
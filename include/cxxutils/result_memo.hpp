@@ -0,0 +1,576 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/optional.hpp"
+#include "cxxutils/result.hpp"
+
+// Memoization of expensive, pure Result-returning functions:
+//
+//     auto lookup = cxxutils::memoize<std::string>(
+//         [&](const std::string & name) { return directory.resolve(name); });
+//     Result<Address> a = lookup("db-primary");
+//
+// Both OK values and failures are cached, failures for a shorter time.
+// Concurrent misses on the same key wait for a single computation. The
+// cache is a fixed number of 8-way sets with CLOCK eviction in each set,
+// and the sets are split between shards that serialize misses. A hit takes
+// no lock: it reads the slots of one set and copies the Result out of the
+// immutable entry it finds. That copy is the one shared write a hit makes,
+// since every hit on an entry bumps the same reference count when the value
+// is a std::shared_ptr or the error a ResultException; the slot's
+// referenced bit is only written when it is clear. Large values are still
+// best memoized as std::shared_ptr<const T>, which costs one such increment
+// rather than a deep copy.
+
+namespace cxxutils {
+
+struct MemoOptions {
+    // Rounded up to a power of two number of 8-way sets, at least one per
+    // shard.
+    std::size_t capacity = 4096;
+    // Rounded up to a power of two.
+    std::size_t shards = 16;
+    // How long entries stay fresh; zero stops them being cached at all.
+    std::chrono::nanoseconds valueTtl = std::chrono::nanoseconds::max();
+    std::chrono::nanoseconds failureTtl = std::chrono::seconds(1);
+};
+
+struct MemoStats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    // Misses that waited for another thread's computation of the same key.
+    std::uint64_t coalesced;
+    std::uint64_t evictions;
+    // Misses on an entry that was present but stale.
+    std::uint64_t expirations;
+
+    double hitRate() const {
+        std::uint64_t lookups = hits + misses + coalesced;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+namespace memo_detail {
+
+using clock = std::chrono::steady_clock;
+
+inline std::uint64_t mix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline std::size_t round_up_pow2(std::size_t n) {
+    std::size_t p = 1;
+    while(p < n)
+        p <<= 1;
+    return p;
+}
+
+inline clock::time_point expiry(clock::time_point now, std::chrono::nanoseconds ttl) {
+    if(ttl == std::chrono::nanoseconds::max() || clock::time_point::max() - now <= ttl)
+        return clock::time_point::max();
+    return now + std::chrono::duration_cast<clock::duration>(ttl);
+}
+
+// Immutable once published. The value and error are kept apart rather than
+// as a Result, so that hits on several threads can copy them without
+// touching a shared Result's usage tracking.
+template<typename K, typename V, typename E>
+struct entry {
+    std::uint64_t hash;
+    K key;
+    optional<V> value;
+    optional<E> error;
+    clock::time_point expires;
+
+    entry(std::uint64_t h, const K & k) : hash(h), key(k) {}
+
+    bool fresh() const {
+        return expires == clock::time_point::max() || clock::now() < expires;
+    }
+
+    Result<V, E> result() const {
+        if(value.hasValue())
+            return Result<V, E>::ok(value.getValue());
+        return Result<V, E>::failed(error.getValue());
+    }
+};
+
+template<typename Entry>
+struct slot {
+    std::atomic<std::shared_ptr<const Entry>*> handle{nullptr};
+    // Low bits of the entry's hash, so lookups only follow the handles that
+    // may match. Only a filter: the entry itself is always checked.
+    std::atomic<std::uint32_t> tag{0};
+    // Set by hits, cleared by the CLOCK hand.
+    std::atomic<bool> referenced{false};
+};
+
+constexpr std::size_t ways = 8;
+
+template<typename Entry>
+struct set {
+    // Next slot the CLOCK hand looks at; guarded by the shard mutex.
+    std::size_t hand = 0;
+    slot<Entry> slots[ways];
+};
+
+// Hits read the slots inside a read section, which costs each thread one
+// atomic exchange on its own cache line. A writer that unpublishes a
+// handle frees it only after every thread that was inside a read section
+// at the time has left it. Hits never wait; a writer waits for the few
+// instructions a hit takes. Each thread's sequence number is odd while it
+// is reading, and the threads are listed in a registry shared by all caches.
+struct alignas(64) reader {
+    std::atomic<std::uint64_t> sequence{0};
+    // Spreads per-thread counters such as hits over several cache lines.
+    std::size_t stripe;
+
+    reader() {
+        registry_t& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        stripe = r.created++;
+        r.readers.push_back(this);
+    }
+
+    ~reader() {
+        registry_t& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for(std::size_t i = 0; i < r.readers.size(); ++i) {
+            if(r.readers[i] == this) {
+                r.readers[i] = r.readers.back();
+                r.readers.pop_back();
+                break;
+            }
+        }
+    }
+
+    // Sequentially consistent, like the writers' exchange of a handle and
+    // the load of sequence in synchronize(), so that either the reader sees
+    // the new handle or the writer sees the reader.
+    void enter() {
+        sequence.exchange(sequence.load(std::memory_order_relaxed) + 1);
+    }
+
+    void leave() {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    static reader& local() {
+        static thread_local reader r;
+        return r;
+    }
+
+    // Returns once every read section that had started when it was called
+    // has finished. Called after unpublishing handles with a sequentially
+    // consistent exchange.
+    static void synchronize() {
+        registry_t& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for(reader* other : r.readers) {
+            std::uint64_t seen = other->sequence.load();
+            if(seen & 1) {
+                while(other->sequence.load(std::memory_order_acquire) == seen)
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct registry_t {
+        std::mutex mutex;
+        std::vector<reader*> readers;
+        std::size_t created = 0;
+    };
+
+    // Deliberately leaked so thread-exit destructors can always reach it.
+    static registry_t& registry() {
+        static registry_t* r = new registry_t();
+        return *r;
+    }
+};
+
+constexpr std::size_t stripes = 16;
+
+// Unpublished handles are queued on their shard and freed this many at a
+// time, after a single synchronize() made outside the shard mutex.
+constexpr std::size_t retire_batch = 32;
+
+// Padded rather than over-aligned, since new only honours extended
+// alignment from C++17; counters 64 bytes apart never share a cache line.
+struct stripe {
+    std::atomic<std::uint64_t> count{0};
+    char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+};
+
+// A computation in progress. It completes with the new entry, or with
+// null if the computation threw, in which case the waiters try again.
+template<typename Entry>
+struct flight {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::shared_ptr<const Entry> done;
+    bool finished = false;
+
+    void complete(std::shared_ptr<const Entry> e) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = std::move(e);
+            finished = true;
+        }
+        cv.notify_all();
+    }
+
+    std::shared_ptr<const Entry> wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return finished; });
+        return done;
+    }
+};
+
+}
+
+// Cache of Result<V, E> keyed by K; see the top of the file. If the
+// function passed to get() throws, the exception reaches its caller and
+// the threads waiting on the same key compute it themselves.
+template<typename K, typename V, typename E = ResultException, typename Hash = std::hash<K>,
+         typename KeyEqual = std::equal_to<K>>
+class MemoCache {
+    using Entry = memo_detail::entry<K, V, E>;
+    using Handle = std::shared_ptr<const Entry>;
+    using Set = memo_detail::set<Entry>;
+    using Flight = memo_detail::flight<Entry>;
+
+public:
+    explicit MemoCache(MemoOptions options = MemoOptions(), Hash hash = Hash(), KeyEqual equal = KeyEqual()) :
+        options_(options), hash_(hash), equal_(equal) {
+        shardCount_ = memo_detail::round_up_pow2(std::max<std::size_t>(options.shards, 1));
+        setCount_ = memo_detail::round_up_pow2(
+            std::max((options.capacity + memo_detail::ways - 1) / memo_detail::ways, shardCount_));
+        sets_.reset(new Set[setCount_]);
+        shards_.reset(new shard[shardCount_]);
+        hits_.reset(new memo_detail::stripe[memo_detail::stripes]);
+    }
+
+    // Not movable, since a moved-from cache would have no sets to look in.
+    // Hold it by pointer to move it around, as Memoized does.
+    MemoCache(const MemoCache &) = delete;
+    MemoCache& operator=(const MemoCache &) = delete;
+
+    ~MemoCache() {
+        for(std::size_t i = 0; i < setCount_; ++i) {
+            for(memo_detail::slot<Entry> & s : sets_[i].slots)
+                delete s.handle.load(std::memory_order_relaxed);
+        }
+        for(std::size_t i = 0; i < shardCount_; ++i) {
+            for(Handle* p : shards_[i].retired)
+                delete p;
+        }
+    }
+
+    // The cached Result for key, or compute(key) cached according to the
+    // options.
+    template<typename FN>
+    Result<V, E> get(const K & key, FN && compute) {
+        std::uint64_t h = memo_detail::mix(static_cast<std::uint64_t>(hash_(key)));
+        std::size_t index = static_cast<std::size_t>(h) & (setCount_ - 1);
+        Set & s = sets_[index];
+        shard & sh = shards_[index & (shardCount_ - 1)];
+
+        bool stale = false;
+        optional<Result<V, E>> hit = lookup(s, h, key, stale);
+        if(hit.hasValue()) {
+            countHit();
+            return hit.takeValue();
+        }
+
+        std::unique_lock<std::mutex> lock(sh.mutex);
+        // Another thread may have finished computing key meanwhile.
+        hit = lookup(s, h, key, stale);
+        if(hit.hasValue()) {
+            lock.unlock();
+            countHit();
+            return hit.takeValue();
+        }
+        auto inflight = sh.inflight.find(key);
+        if(inflight != sh.inflight.end()) {
+            std::shared_ptr<Flight> f = inflight->second;
+            lock.unlock();
+            sh.coalesced.fetch_add(1, std::memory_order_relaxed);
+            if(Handle done = f->wait())
+                return done->result();
+            // The computation threw; compute key here instead.
+            return get(key, compute);
+        }
+        sh.misses.fetch_add(1, std::memory_order_relaxed);
+        if(stale)
+            sh.expirations.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<Flight> f = std::make_shared<Flight>();
+        sh.inflight.emplace(key, f);
+        lock.unlock();
+
+        // Releases the waiters if anything below throws.
+        struct abandon {
+            shard & sh;
+            std::unique_lock<std::mutex> & lock;
+            const K & key;
+            Flight* f;
+
+            ~abandon() {
+                if(!f)
+                    return;
+                if(!lock.owns_lock())
+                    lock.lock();
+                sh.inflight.erase(key);
+                lock.unlock();
+                f->complete(nullptr);
+            }
+        } guard{sh, lock, key, f.get()};
+
+        Result<V, E> r = compute(key);
+        std::shared_ptr<Entry> computed = std::make_shared<Entry>(h, key);
+        std::chrono::nanoseconds ttl;
+        if(r.isOK()) {
+            computed->value.emplace(r.getValue());
+            ttl = options_.valueTtl;
+        } else {
+            computed->error.emplace(r.getException());
+            ttl = options_.failureTtl;
+        }
+        computed->expires = memo_detail::expiry(memo_detail::clock::now(), ttl);
+
+        lock.lock();
+        if(ttl > std::chrono::nanoseconds::zero())
+            insert(s, sh, computed);
+        sh.inflight.erase(key);
+        std::vector<Handle*> batch = takeRetired(sh);
+        lock.unlock();
+        guard.f = nullptr;
+        f->complete(std::move(computed));
+        reclaim(batch);
+        return r;
+    }
+
+    // Drops key's entry, if any. A computation of key already in progress
+    // still stores its result.
+    void invalidate(const K & key) {
+        std::uint64_t h = memo_detail::mix(static_cast<std::uint64_t>(hash_(key)));
+        std::size_t index = static_cast<std::size_t>(h) & (setCount_ - 1);
+        Set & s = sets_[index];
+        shard & sh = shards_[index & (shardCount_ - 1)];
+        std::unique_lock<std::mutex> lock(sh.mutex);
+        for(memo_detail::slot<Entry> & sl : s.slots) {
+            Handle* p = sl.handle.load(std::memory_order_relaxed);
+            if(p && (*p)->hash == h && equal_((*p)->key, key)) {
+                sh.retired.push_back(sl.handle.exchange(nullptr));
+                std::vector<Handle*> batch = takeRetired(sh);
+                lock.unlock();
+                reclaim(batch);
+                return;
+            }
+        }
+    }
+
+    void clear() {
+        std::vector<Handle*> removed;
+        for(std::size_t i = 0; i < setCount_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i & (shardCount_ - 1)].mutex);
+            for(memo_detail::slot<Entry> & sl : sets_[i].slots) {
+                if(Handle* p = sl.handle.exchange(nullptr))
+                    removed.push_back(p);
+            }
+        }
+        for(std::size_t i = 0; i < shardCount_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            removed.insert(removed.end(), shards_[i].retired.begin(), shards_[i].retired.end());
+            shards_[i].retired.clear();
+        }
+        reclaim(removed);
+    }
+
+    // Entries currently held, fresh or not.
+    std::size_t size() const {
+        std::size_t n = 0;
+        for(std::size_t i = 0; i < setCount_; ++i) {
+            for(const memo_detail::slot<Entry> & sl : sets_[i].slots)
+                n += sl.handle.load(std::memory_order_relaxed) != nullptr;
+        }
+        return n;
+    }
+
+    std::size_t capacity() const {
+        return setCount_ * memo_detail::ways;
+    }
+
+    MemoStats stats() const {
+        MemoStats out{0, 0, 0, 0, 0};
+        for(std::size_t i = 0; i < memo_detail::stripes; ++i)
+            out.hits += hits_[i].count.load(std::memory_order_relaxed);
+        for(std::size_t i = 0; i < shardCount_; ++i) {
+            const shard & sh = shards_[i];
+            out.misses += sh.misses.load(std::memory_order_relaxed);
+            out.coalesced += sh.coalesced.load(std::memory_order_relaxed);
+            out.evictions += sh.evictions.load(std::memory_order_relaxed);
+            out.expirations += sh.expirations.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+private:
+    struct shard {
+        std::mutex mutex;
+        std::unordered_map<K, std::shared_ptr<Flight>, Hash, KeyEqual> inflight;
+        // Unpublished handles not yet freed.
+        std::vector<Handle*> retired;
+        std::atomic<std::uint64_t> misses{0};
+        std::atomic<std::uint64_t> coalesced{0};
+        std::atomic<std::uint64_t> evictions{0};
+        std::atomic<std::uint64_t> expirations{0};
+    };
+
+    // The fresh cached Result for key, if any. The Result is built inside the
+    // read section, so a hit copies the value but not the handle.
+    // stale is set if key's entry has expired.
+    optional<Result<V, E>> lookup(Set & s, std::uint64_t h, const K & key, bool & stale) const {
+        optional<Result<V, E>> found;
+        memo_detail::reader& self = memo_detail::reader::local();
+        self.enter();
+        for(memo_detail::slot<Entry> & sl : s.slots) {
+            if(sl.tag.load(std::memory_order_relaxed) != static_cast<std::uint32_t>(h))
+                continue;
+            Handle* p = sl.handle.load();
+            if(p && (*p)->hash == h && equal_((*p)->key, key)) {
+                if((*p)->fresh()) {
+                    found.emplace((*p)->result());
+                    if(!sl.referenced.load(std::memory_order_relaxed))
+                        sl.referenced.store(true, std::memory_order_relaxed);
+                } else {
+                    stale = true;
+                }
+                break;
+            }
+        }
+        self.leave();
+        return found;
+    }
+
+    // Called with the shard mutex held. Replaces key's entry if the set has
+    // one, else fills an empty slot, else evicts with the CLOCK hand, which
+    // passes over referenced entries once, clearing their bit, and takes
+    // stale ones first. The handle it replaces is queued on the shard.
+    void insert(Set & s, shard & sh, Handle e) {
+        memo_detail::slot<Entry>* target = nullptr;
+        memo_detail::slot<Entry>* empty = nullptr;
+        for(memo_detail::slot<Entry> & sl : s.slots) {
+            Handle* p = sl.handle.load(std::memory_order_relaxed);
+            if(!p) {
+                if(!empty)
+                    empty = &sl;
+            } else if((*p)->hash == e->hash && equal_((*p)->key, e->key)) {
+                target = &sl;
+                break;
+            }
+        }
+        bool evicting = false;
+        if(!target)
+            target = empty;
+        while(!target) {
+            memo_detail::slot<Entry> & sl = s.slots[s.hand];
+            s.hand = (s.hand + 1) % memo_detail::ways;
+            if(sl.referenced.load(std::memory_order_relaxed) && (*sl.handle.load(std::memory_order_relaxed))->fresh()) {
+                sl.referenced.store(false, std::memory_order_relaxed);
+            } else {
+                target = &sl;
+                evicting = true;
+            }
+        }
+        target->referenced.store(false, std::memory_order_relaxed);
+        target->tag.store(static_cast<std::uint32_t>(e->hash), std::memory_order_relaxed);
+        if(Handle* old = target->handle.exchange(new Handle(std::move(e))))
+            sh.retired.push_back(old);
+        if(evicting)
+            sh.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Hits are counted per thread stripe rather than per shard, so hits on
+    // different threads do not write to the same cache line.
+    void countHit() {
+        memo_detail::stripe & h = hits_[memo_detail::reader::local().stripe % memo_detail::stripes];
+        h.count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called with the shard mutex held. The shard's retired handles, once
+    // there are enough of them to be worth a synchronize().
+    static std::vector<Handle*> takeRetired(shard & sh) {
+        std::vector<Handle*> batch;
+        if(sh.retired.size() >= memo_detail::retire_batch)
+            batch.swap(sh.retired);
+        return batch;
+    }
+
+    // Frees unpublished handles once no hit can still be reading them. Called
+    // without any shard mutex held.
+    static void reclaim(const std::vector<Handle*> & batch) {
+        if(batch.empty())
+            return;
+        memo_detail::reader::synchronize();
+        for(Handle* p : batch)
+            delete p;
+    }
+
+    MemoOptions options_;
+    Hash hash_;
+    KeyEqual equal_;
+    std::size_t shardCount_;
+    std::size_t setCount_;
+    std::unique_ptr<Set[]> sets_;
+    std::unique_ptr<shard[]> shards_;
+    std::unique_ptr<memo_detail::stripe[]> hits_;
+};
+
+// A function together with the MemoCache of its results. The cache lives
+// on the heap so a Memoized can be moved; a moved-from Memoized can only be
+// destroyed or assigned to.
+template<typename K, typename FN, typename V, typename E, typename Hash = std::hash<K>>
+class Memoized {
+public:
+    Memoized(FN fn, MemoOptions options) : cache_(new MemoCache<K, V, E, Hash>(options)), fn_(std::move(fn)) {}
+
+    Result<V, E> operator()(const K & key) {
+        return cache_->get(key, fn_);
+    }
+
+    MemoCache<K, V, E, Hash>& cache() {
+        return *cache_;
+    }
+
+    MemoStats stats() const {
+        return cache_->stats();
+    }
+
+private:
+    std::unique_ptr<MemoCache<K, V, E, Hash>> cache_;
+    FN fn_;
+};
+
+template<typename K, typename FN, typename R = decltype(std::declval<FN&>()(std::declval<const K&>()))>
+Memoized<K, FN, typename R::value_type, typename R::error_type> memoize(FN fn, MemoOptions options = MemoOptions()) {
+    return Memoized<K, FN, typename R::value_type, typename R::error_type>(std::move(fn), options);
+}
+
+}
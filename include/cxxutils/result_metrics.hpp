@@ -0,0 +1,229 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Opt-in failure counters per ResultException component. Define
+// CXXUTILS_RESULT_METRICS (consistently, for the whole program) to record
+// every failure created and every failure propagated into another Result;
+// without it the recording hooks are empty inline functions and snapshots
+// are always empty.
+//
+// Components get a dense id when first interned; ids at or beyond
+// CXXUTILS_RESULT_METRICS_MAX_COMPONENTS share the last slot, reported as
+// "(other)".
+
+#ifndef CXXUTILS_RESULT_METRICS_MAX_COMPONENTS
+#define CXXUTILS_RESULT_METRICS_MAX_COMPONENTS 256
+#endif
+
+namespace cxxutils {
+
+struct ComponentFailureStats {
+    std::string component;
+    std::uint64_t created;
+    std::uint64_t propagated;
+    // Per second since the previous snapshot; zero for a first snapshot.
+    double createdRate;
+    double propagatedRate;
+};
+
+struct ResultMetricsSnapshot {
+    std::chrono::steady_clock::time_point takenAt;
+    // Components that have recorded at least one failure, in id order.
+    std::vector<ComponentFailureStats> components;
+};
+
+namespace metrics_detail {
+
+constexpr std::size_t maxComponents = CXXUTILS_RESULT_METRICS_MAX_COMPONENTS;
+
+static_assert(maxComponents >= 2, "need at least one component slot plus (other)");
+
+inline std::size_t slot_for(std::size_t id) {
+    return id < maxComponents - 1 ? id : maxComponents - 1;
+}
+
+// Same sharding scheme as the object pool counters: each thread counts into
+// its own shard with plain relaxed load/store pairs (it is the only writer),
+// so recording takes no lock and never allocates once the thread's shard
+// exists. Readers sum the live shards and the totals of exited threads.
+class failure_counters {
+public:
+    static void created(std::size_t id) {
+        bump(local().created[slot_for(id)]);
+    }
+
+    static void propagated(std::size_t id) {
+        bump(local().propagated[slot_for(id)]);
+    }
+
+    // Called when a component is interned, never on the hot path.
+    static void name_component(std::size_t id, const std::string & name) {
+        registry_t& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        std::size_t slot = slot_for(id);
+        if(r.names.size() <= slot)
+            r.names.resize(slot + 1);
+        r.names[slot] = slot == maxComponents - 1 ? "(other)" : name;
+    }
+
+    static ResultMetricsSnapshot snapshot() {
+        registry_t& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        ResultMetricsSnapshot out;
+        out.takenAt = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < r.names.size(); ++i) {
+            std::uint64_t created = r.retiredCreated[i];
+            std::uint64_t propagated = r.retiredPropagated[i];
+            for(shard* s : r.shards) {
+                created += s->created[i].load(std::memory_order_relaxed);
+                propagated += s->propagated[i].load(std::memory_order_relaxed);
+            }
+            if(created || propagated)
+                out.components.push_back(ComponentFailureStats{r.names[i], created, propagated, 0.0, 0.0});
+        }
+        return out;
+    }
+
+private:
+    using counter = std::atomic<std::uint64_t>;
+
+    static void bump(counter & c) {
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    struct shard {
+        counter created[maxComponents];
+        counter propagated[maxComponents];
+
+        shard() {
+            for(std::size_t i = 0; i < maxComponents; ++i) {
+                created[i].store(0, std::memory_order_relaxed);
+                propagated[i].store(0, std::memory_order_relaxed);
+            }
+            registry_t& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.shards.push_back(this);
+        }
+
+        ~shard() {
+            registry_t& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for(std::size_t i = 0; i < maxComponents; ++i) {
+                r.retiredCreated[i] += created[i].load(std::memory_order_relaxed);
+                r.retiredPropagated[i] += propagated[i].load(std::memory_order_relaxed);
+            }
+            for(std::size_t i = 0; i < r.shards.size(); ++i) {
+                if(r.shards[i] == this) {
+                    r.shards[i] = r.shards.back();
+                    r.shards.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    struct registry_t {
+        std::mutex mutex;
+        std::vector<shard*> shards;
+        std::vector<std::string> names;
+        std::uint64_t retiredCreated[maxComponents] = {};
+        std::uint64_t retiredPropagated[maxComponents] = {};
+    };
+
+    // Deliberately leaked so thread-exit shard destructors can always reach it.
+    static registry_t& registry() {
+        static registry_t* r = new registry_t();
+        return *r;
+    }
+
+    static shard& local() {
+        static thread_local shard s;
+        return s;
+    }
+};
+
+#ifdef CXXUTILS_RESULT_METRICS
+inline void record_created(std::size_t id) { failure_counters::created(id); }
+inline void record_propagated(std::size_t id) { failure_counters::propagated(id); }
+inline void record_component(std::size_t id, const std::string & name) { failure_counters::name_component(id, name); }
+#else
+inline void record_created(std::size_t) {}
+inline void record_propagated(std::size_t) {}
+inline void record_component(std::size_t, const std::string &) {}
+#endif
+
+}
+
+class ResultMetrics {
+public:
+#ifdef CXXUTILS_RESULT_METRICS
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    // Cumulative counts since program start.
+    static ResultMetricsSnapshot snapshot() {
+        return metrics_detail::failure_counters::snapshot();
+    }
+
+    // Cumulative counts, with rates computed against an earlier snapshot.
+    static ResultMetricsSnapshot snapshot(const ResultMetricsSnapshot & previous) {
+        ResultMetricsSnapshot current = snapshot();
+        double seconds = std::chrono::duration<double>(current.takenAt - previous.takenAt).count();
+        if(seconds <= 0)
+            return current;
+        for(ComponentFailureStats & c : current.components) {
+            std::uint64_t created = 0;
+            std::uint64_t propagated = 0;
+            for(const ComponentFailureStats & p : previous.components) {
+                if(p.component == c.component) {
+                    created = p.created;
+                    propagated = p.propagated;
+                    break;
+                }
+            }
+            c.createdRate = (c.created - created) / seconds;
+            c.propagatedRate = (c.propagated - propagated) / seconds;
+        }
+        return current;
+    }
+
+    // Prometheus text exposition format, suitable for serving from a local
+    // scrape endpoint or writing to a file for a node exporter to pick up.
+    static void writePrometheus(std::ostream & os, const ResultMetricsSnapshot & s) {
+        os << "# HELP cxxutils_result_failures_created_total Failed Results created, by component.\n"
+           << "# TYPE cxxutils_result_failures_created_total counter\n";
+        for(const ComponentFailureStats & c : s.components)
+            os << "cxxutils_result_failures_created_total{component=\"" << escaped(c.component) << "\"} " << c.created << "\n";
+        os << "# HELP cxxutils_result_failures_propagated_total Failures propagated into another Result, by component.\n"
+           << "# TYPE cxxutils_result_failures_propagated_total counter\n";
+        for(const ComponentFailureStats & c : s.components)
+            os << "cxxutils_result_failures_propagated_total{component=\"" << escaped(c.component) << "\"} " << c.propagated << "\n";
+    }
+
+private:
+    static std::string escaped(const std::string & label) {
+        std::string out;
+        for(char ch : label) {
+            if(ch == '\\' || ch == '"')
+                out += '\\';
+            if(ch == '\n') {
+                out += "\\n";
+                continue;
+            }
+            out += ch;
+        }
+        return out;
+    }
+};
+
+}
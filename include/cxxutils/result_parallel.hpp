@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cxxutils/result_batch.hpp"
+#include "cxxutils/thread_pool.hpp"
+
+namespace ResultUtils {
+
+namespace parallel_detail {
+
+// Shared between the calling thread and the helper tasks, which may still be
+// queued after the call has returned.
+template<typename U, typename E>
+struct traverse_state {
+    static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+    explicit traverse_state(std::size_t n, std::size_t grain) :
+        values(n), grain(grain), chunks((n + grain - 1) / grain) {}
+
+    std::vector<optional<U>> values;
+    std::size_t grain;
+    std::size_t chunks;
+    std::atomic<std::size_t> nextChunk{0};
+    std::atomic<std::size_t> doneChunks{0};
+
+    // Lowest failing index seen so far. Items above it are cancelled, items
+    // below it still run, so the final value is the lowest failing index.
+    // The failure there is either an error or an exception thrown by fn.
+    std::atomic<std::size_t> firstFailure{none};
+    std::mutex errorMutex;
+    optional<E> error;
+#ifndef CXXUTILS_NO_EXCEPTIONS
+    std::exception_ptr exception;
+#endif
+
+    std::mutex doneMutex;
+    std::condition_variable doneCv;
+
+    void fail(std::size_t index, const E & e) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        std::size_t current = firstFailure.load(std::memory_order_relaxed);
+        if(index < current) {
+            error.emplace(e);
+#ifndef CXXUTILS_NO_EXCEPTIONS
+            exception = nullptr;
+#endif
+            firstFailure.store(index, std::memory_order_release);
+        }
+    }
+
+#ifndef CXXUTILS_NO_EXCEPTIONS
+    void fail(std::size_t index, std::exception_ptr p) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        std::size_t current = firstFailure.load(std::memory_order_relaxed);
+        if(index < current) {
+            error.reset();
+            exception = std::move(p);
+            firstFailure.store(index, std::memory_order_release);
+        }
+    }
+#endif
+
+    template<typename It, typename FN>
+    void run(std::size_t i, It first, FN & fn) {
+        auto r = fn(*std::next(first, i));
+        if(r.isOK())
+            values[i].emplace(r.takeValue());
+        else
+            fail(i, result_error_converter<typename decltype(r)::error_type, E>::convert(r.getException()));
+    }
+
+    // Never throws: an exception from fn is recorded against its index like
+    // an error, so the chunk still counts as done.
+    template<typename It, typename FN>
+    void work(It first, FN & fn) {
+        while(true) {
+            std::size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if(chunk >= chunks)
+                return;
+            std::size_t begin = chunk * grain;
+            std::size_t end = std::min(begin + grain, values.size());
+            for(std::size_t i = begin; i < end; ++i) {
+                if(i > firstFailure.load(std::memory_order_acquire))
+                    break;
+#ifdef CXXUTILS_NO_EXCEPTIONS
+                run(i, first, fn);
+#else
+                try {
+                    run(i, first, fn);
+                } catch(...) {
+                    fail(i, std::current_exception());
+                }
+#endif
+            }
+            if(doneChunks.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                doneCv.notify_all();
+            }
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCv.wait(lock, [this] {
+            return doneChunks.load(std::memory_order_acquire) == chunks;
+        });
+    }
+};
+
+}
+
+// Parallel form of traverse: applies a Result-returning fn to every element
+// of a random-access range on a work-stealing pool. Values come back in
+// input order. On failure the error reported is the one from the lowest
+// failing index, and work on higher indices is cancelled cooperatively.
+// If fn throws at that index, the exception is rethrown on the caller once
+// every chunk has finished.
+// fn is called concurrently and must be safe to call from several threads.
+template<typename R, typename FN>
+auto parallel_traverse(const R & range, FN fn,
+                       cxxutils::WorkStealingPool & pool = cxxutils::WorkStealingPool::global())
+    -> Result<std::vector<typename batch_detail::result_of_element<FN, const R>::value_type>,
+              typename batch_detail::result_of_element<FN, const R>::error_type> {
+    using ELEMENT = batch_detail::result_of_element<FN, const R>;
+    using U = typename ELEMENT::value_type;
+    using E = typename ELEMENT::error_type;
+    using RESULT = Result<std::vector<U>, E>;
+    using State = parallel_detail::traverse_state<U, E>;
+    using It = decltype(std::begin(range));
+
+    It first = std::begin(range);
+    std::size_t n = static_cast<std::size_t>(std::distance(first, std::end(range)));
+    if(n == 0)
+        return RESULT::ok(std::vector<U>());
+
+    std::size_t grain = std::max<std::size_t>(1, n / (pool.size() * 8));
+    std::shared_ptr<State> state = std::make_shared<State>(n, grain);
+    std::shared_ptr<FN> shared_fn = std::make_shared<FN>(std::move(fn));
+
+    {
+        // Helpers read the caller's range, so this call must not return or
+        // unwind until every chunk is done, even if submitting throws.
+        struct drain_guard {
+            State & state;
+            It first;
+            FN & fn;
+
+            ~drain_guard() {
+                state.work(first, fn);
+                state.wait();
+            }
+        } guard{*state, first, *shared_fn};
+
+        std::size_t helpers = std::min(pool.size(), state->chunks) - 1;
+        for(std::size_t i = 0; i < helpers; ++i)
+            pool.submit([state, shared_fn, first] { state->work(first, *shared_fn); });
+    }
+
+#ifndef CXXUTILS_NO_EXCEPTIONS
+    if(state->exception)
+        std::rethrow_exception(state->exception);
+#endif
+    if(state->firstFailure.load(std::memory_order_acquire) != State::none) {
+        result_detail::record_propagated(state->error.getValue());
+        return RESULT::failed(state->error.takeValue());
+    }
+
+    std::vector<U> values;
+    values.reserve(n);
+    for(optional<U> & v : state->values)
+        values.push_back(v.takeValue());
+    return RESULT::ok(std::move(values));
+}
+
+// Parallel traverse over the value of a Result, so an existing flatmap
+// chain can fan out: r.flatmap(...) becomes parallel_traverse(r, fn).
+template<typename T, typename E, typename FN>
+auto parallel_traverse(const Result<std::vector<T>, E> & input, FN fn,
+                       cxxutils::WorkStealingPool & pool = cxxutils::WorkStealingPool::global())
+    -> decltype(parallel_traverse(input.getValue(), fn, pool)) {
+    using RESULT = decltype(parallel_traverse(input.getValue(), fn, pool));
+    if(!input.isOK())
+        return RESULT::translateError(input);
+    return parallel_traverse(input.getValue(), std::move(fn), pool);
+}
+
+// Parallel map with an infallible fn, returning the values in input order.
+template<typename R, typename FN>
+auto parallel_map(const R & range, FN fn,
+                  cxxutils::WorkStealingPool & pool = cxxutils::WorkStealingPool::global())
+    -> Result<std::vector<typename std::decay<decltype(fn(*std::begin(range)))>::type>> {
+    using U = typename std::decay<decltype(fn(*std::begin(range)))>::type;
+    return parallel_traverse(range, [fn](const typename std::decay<decltype(*std::begin(range))>::type & v) {
+        return Result<U>::ok(fn(v));
+    }, pool);
+}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+// Zero-copy parsing of delimited text into Results. Lines and fields are
+// string_views into the caller's buffer and numbers are converted in place
+// with std::from_chars, so parsing does not allocate. Failures are a
+// ParseError carrying the byte offset of the problem in the input:
+//
+//     cxxutils::LineScanner lines(buffer);
+//     for(optional<std::string_view> line = lines.next(); line.hasValue(); line = lines.next()) {
+//         cxxutils::FieldSplitter fields(line.getValue(), ',', lines.offset());
+//         Result<long, cxxutils::ParseError> id = fields.nextAs<long>();
+//         ...
+//     }
+//
+// A Result<T, ParseError> converts to Result<T> (translateError, flatmap,
+// co_await) with a message such as "invalid number at offset 1042".
+
+#if !(__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#error "cxxutils/result_parse.hpp requires C++17"
+#endif
+
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "cxxutils/optional.hpp"
+#include "cxxutils/result.hpp"
+
+namespace cxxutils {
+
+enum class ParseErrc { empty_field, invalid_number, out_of_range, trailing_characters, missing_field };
+
+// Trivially copyable, so Result<T, ParseError> is too and failing costs no
+// more than succeeding.
+struct ParseError {
+    ParseErrc code;
+    std::size_t offset;
+
+    const char* message() const {
+        switch(code) {
+        case ParseErrc::empty_field: return "empty field";
+        case ParseErrc::invalid_number: return "invalid number";
+        case ParseErrc::out_of_range: return "number out of range";
+        case ParseErrc::trailing_characters: return "unexpected characters";
+        case ParseErrc::missing_field: return "missing field";
+        }
+        return "parse error";
+    }
+};
+
+namespace parse_detail {
+
+inline std::size_t lowest_bit(unsigned mask) {
+#if defined(__GNUC__)
+    return static_cast<std::size_t>(__builtin_ctz(mask));
+#else
+    std::size_t n = 0;
+    for(; !(mask & 1); mask >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// First occurrence of c in [p, end), or end. Compares 16 bytes at a time
+// where SSE2 is available. Inline rather than memchr, because fields and
+// lines are short enough that the call would dominate.
+inline const char* find_byte(const char* p, const char* end, char c) {
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i needle = _mm_set1_epi8(c);
+    for(; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        if(mask)
+            return p + lowest_bit(mask);
+    }
+#endif
+    for(; p != end; ++p) {
+        if(*p == c)
+            return p;
+    }
+    return end;
+}
+
+}
+
+// Parses the whole of field as a number: no leading whitespace or '+', and
+// nothing after it. offset is the position of field in the input and is
+// added to the position reported in a failure.
+template<typename T>
+Result<T, ParseError> parse_number(std::string_view field, std::size_t offset = 0) {
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                  "parse_number parses integers and floating point numbers");
+    if(field.empty())
+        return Result<T, ParseError>::failed(ParseError{ParseErrc::empty_field, offset});
+    const char* first = field.data();
+    const char* last = first + field.size();
+    T value{};
+    std::from_chars_result r = std::from_chars(first, last, value);
+    if(r.ec == std::errc::invalid_argument)
+        return Result<T, ParseError>::failed(ParseError{ParseErrc::invalid_number, offset});
+    if(r.ec == std::errc::result_out_of_range)
+        return Result<T, ParseError>::failed(ParseError{ParseErrc::out_of_range, offset});
+    if(r.ptr != last)
+        return Result<T, ParseError>::failed(
+            ParseError{ParseErrc::trailing_characters, offset + static_cast<std::size_t>(r.ptr - first)});
+    return Result<T, ParseError>::ok(value);
+}
+
+// Splits text into lines on '\n', dropping a '\r' before it. A final line
+// without a newline is returned too; a trailing newline does not produce an
+// empty last line.
+class LineScanner {
+public:
+    explicit LineScanner(std::string_view text) : text_(text), pos_(0), offset_(0) {}
+
+    optional<std::string_view> next() {
+        if(pos_ >= text_.size())
+            return optional<std::string_view>();
+        const char* begin = text_.data() + pos_;
+        const char* end = text_.data() + text_.size();
+        const char* newline = parse_detail::find_byte(begin, end, '\n');
+        std::size_t length = static_cast<std::size_t>(newline - begin);
+        offset_ = pos_;
+        pos_ += length + 1;
+        if(newline != end && length > 0 && begin[length - 1] == '\r')
+            --length;
+        return optional<std::string_view>(std::string_view(begin, length));
+    }
+
+    // Offset in the input of the line last returned by next().
+    std::size_t offset() const {
+        return offset_;
+    }
+
+private:
+    std::string_view text_;
+    std::size_t pos_;
+    std::size_t offset_;
+};
+
+// Splits text into fields on a single byte delimiter; n delimiters make n+1
+// fields, so an empty text is one empty field. base is the offset of text in
+// the input and is used for the offsets in failures.
+class FieldSplitter {
+public:
+    FieldSplitter(std::string_view text, char delimiter, std::size_t base = 0) :
+        text_(text), delimiter_(delimiter), base_(base), pos_(0), done_(false) {}
+
+    bool atEnd() const {
+        return done_;
+    }
+
+    // Offset in the input of the next field.
+    std::size_t offset() const {
+        return base_ + pos_;
+    }
+
+    Result<std::string_view, ParseError> next() {
+        if(done_)
+            return Result<std::string_view, ParseError>::failed(ParseError{ParseErrc::missing_field, offset()});
+        const char* begin = text_.data() + pos_;
+        const char* end = text_.data() + text_.size();
+        const char* delim = parse_detail::find_byte(begin, end, delimiter_);
+        std::size_t length = static_cast<std::size_t>(delim - begin);
+        pos_ += length + 1;
+        done_ = delim == end;
+        return Result<std::string_view, ParseError>::ok(std::string_view(begin, length));
+    }
+
+    // The next field parsed with parse_number.
+    template<typename T>
+    Result<T, ParseError> nextAs() {
+        std::size_t at = offset();
+        Result<std::string_view, ParseError> field = next();
+        if(!field.isOK())
+            return Result<T, ParseError>::translateError(field);
+        return parse_number<T>(field.getValue(), at);
+    }
+
+    // Fails with trailing_characters if any fields are left.
+    Result<void, ParseError> expectEnd() const {
+        if(!done_)
+            return Result<void, ParseError>::failed(ParseError{ParseErrc::trailing_characters, offset()});
+        return Result<void, ParseError>::ok();
+    }
+
+private:
+    std::string_view text_;
+    char delimiter_;
+    std::size_t base_;
+    std::size_t pos_;
+    bool done_;
+};
+
+}
+
+template<>
+struct result_error_converter<cxxutils::ParseError, ResultException> {
+    static ResultException convert(const cxxutils::ParseError & e) {
+        static const ResultComponent component("parse");
+        char mesg[64];
+        std::snprintf(mesg, sizeof(mesg), "%s at offset %zu", e.message(), e.offset);
+        return ResultException(component, mesg);
+    }
+};
@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/cxx14shims.hpp"
+#include "cxxutils/result.hpp"
+
+namespace ResultUtils {
+
+// A record that failed in a pipeline: its position in the input, the index
+// of the stage that failed it, and the error converted to ResultException.
+struct PipelineFailure {
+    std::size_t record;
+    std::size_t stage;
+    ResultException error;
+};
+
+// Counters for one stage, cumulative over every run of the pipeline. busy
+// is the time spent inside the stage function, so throughput and latency
+// exclude time spent waiting on the neighbouring stages.
+struct StageStats {
+    std::string name;
+    std::uint64_t batches;
+    std::uint64_t recordsIn;
+    std::uint64_t recordsOut;
+    std::uint64_t failures;
+    std::chrono::nanoseconds busy;
+    std::chrono::nanoseconds slowestBatch;
+
+    // Records per second of busy time.
+    double throughput() const {
+        return busy.count() == 0 ? 0.0 : static_cast<double>(recordsIn) * 1e9 / static_cast<double>(busy.count());
+    }
+
+    std::chrono::nanoseconds meanLatency() const {
+        return recordsIn == 0 ? std::chrono::nanoseconds(0)
+                              : std::chrono::nanoseconds(busy.count() / static_cast<std::int64_t>(recordsIn));
+    }
+};
+
+struct PipelineOptions {
+    // Records per batch.
+    std::size_t batchSize = 256;
+    // Batches each inter-stage queue holds before the producer waits.
+    std::size_t queueCapacity = 8;
+    // Runs every stage on its own thread; otherwise each batch goes through
+    // all the stages in turn on the calling thread.
+    bool concurrent = true;
+};
+
+struct PipelineRun {
+    std::size_t recordsIn;
+    std::size_t delivered;
+    // Failed records ordered by record index; empty if a failure handler
+    // was installed.
+    std::vector<PipelineFailure> failures;
+};
+
+namespace pipeline_detail {
+
+// A batch carries each record's input position along with it, so failures
+// in later stages can still be reported against the original record.
+template<typename T>
+struct batch {
+    std::vector<T> items;
+    std::vector<std::size_t> ids;
+    bool last = false;
+};
+
+// Bounded single-producer single-consumer ring. Each stage thread is the
+// only producer of its output queue and the only consumer of its input, so
+// head and tail each have a single writer and no locks are needed while
+// batches keep flowing. Waiting spins, then yields, and past a bound sleeps
+// on a condition variable, so a stalled neighbour does not keep a core busy.
+template<typename T>
+class spsc_queue {
+public:
+    explicit spsc_queue(std::size_t capacity) : slots_(std::max<std::size_t>(capacity, 1) + 1) {}
+
+    void push(T && value) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t next = tail + 1 == slots_.size() ? 0 : tail + 1;
+        waitUntil([&] { return next != head_.load(); });
+        slots_[tail] = std::move(value);
+        tail_.store(next);
+        wake();
+    }
+
+    T pop() {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        waitUntil([&] { return head != tail_.load(); });
+        T value = std::move(slots_[head]);
+        head_.store(head + 1 == slots_.size() ? 0 : head + 1);
+        wake();
+        return value;
+    }
+
+private:
+    static constexpr unsigned spinLimit = 1024;
+
+    // The index stores and loads, and the sleepers count, are sequentially
+    // consistent, so either the waiter sees the new index or the other side
+    // sees the waiter.
+    template<typename Ready>
+    void waitUntil(Ready ready) {
+        for(unsigned spins = 0; spins < spinLimit; ++spins) {
+            if(ready())
+                return;
+            if(spins >= 64)
+                std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        cv_.wait(lock, ready);
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake() {
+        if(sleepers_.load() == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        cv_.notify_all();
+    }
+
+    std::vector<T> slots_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::atomic<unsigned> sleepers_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// Written only by the stage's thread; relaxed atomics so stats() can be
+// read while a run is in progress.
+struct stage_counters {
+    std::atomic<std::uint64_t> batches{0};
+    std::atomic<std::uint64_t> recordsIn{0};
+    std::atomic<std::uint64_t> recordsOut{0};
+    std::atomic<std::uint64_t> failures{0};
+    std::atomic<std::int64_t> busyNanos{0};
+    std::atomic<std::int64_t> slowestNanos{0};
+
+    static void add(std::atomic<std::uint64_t> & c, std::uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void record(std::size_t in, std::size_t out, std::size_t failed, std::int64_t nanos) {
+        add(batches, 1);
+        add(recordsIn, in);
+        add(recordsOut, out);
+        add(failures, failed);
+        busyNanos.store(busyNanos.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+        if(nanos > slowestNanos.load(std::memory_order_relaxed))
+            slowestNanos.store(nanos, std::memory_order_relaxed);
+    }
+};
+
+using failure_handler = std::function<void(const PipelineFailure &)>;
+
+// Failures from one stage thread. With a handler they are passed on as they
+// happen, otherwise kept for the run's report.
+struct failure_log {
+    const failure_handler* handler = nullptr;
+    std::vector<PipelineFailure> failures;
+
+    void fail(std::size_t record, std::size_t stage, ResultException && error) {
+        PipelineFailure f{record, stage, std::move(error)};
+        if(handler && *handler)
+            (*handler)(f);
+        else
+            failures.push_back(std::move(f));
+    }
+};
+
+template<typename T, typename FN>
+struct stage {
+    using input_type = T;
+    using result_type = typename std::decay<decltype(std::declval<FN&>()(std::declval<T&&>()))>::type;
+    using output_type = typename result_type::value_type;
+    using error_type = typename result_type::error_type;
+
+    static_assert(!std::is_void<output_type>::value, "pipeline stages must produce a value");
+
+    std::string name;
+    FN fn;
+    std::unique_ptr<stage_counters> counters;
+
+    // Runs fn over every record of in. Failed records leave the batch and go
+    // to log; the rest move on in order.
+    batch<output_type> process(std::size_t index, batch<T> && in, failure_log & log) {
+        auto start = std::chrono::steady_clock::now();
+        batch<output_type> out;
+        out.items.reserve(in.items.size());
+        out.ids.reserve(in.ids.size());
+        out.last = in.last;
+        std::size_t failed = 0;
+        for(std::size_t i = 0; i < in.items.size(); ++i) {
+            result_type r = fn(std::move(in.items[i]));
+            if(r.isOK()) {
+                out.items.push_back(r.takeValue());
+                out.ids.push_back(in.ids[i]);
+            } else {
+                ++failed;
+                result_detail::record_propagated(r.getException());
+                log.fail(in.ids[i], index, ResultException(result_error_converter<error_type, ResultException>::convert(r.getException())));
+            }
+        }
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        counters->record(in.items.size(), out.items.size(), failed, static_cast<std::int64_t>(nanos));
+        return out;
+    }
+};
+
+template<typename In, typename... Stages>
+struct output_of {
+    using type = In;
+};
+
+template<typename In, typename S, typename... Rest>
+struct output_of<In, S, Rest...> : output_of<typename S::output_type, Rest...> {};
+
+}
+
+// Runs records through a chain of Result-returning stages, a batch at a
+// time:
+//
+//     auto pipeline = ResultUtils::Pipeline<std::string>()
+//         .then("parse", parseRecord)      // std::string -> Result<Record>
+//         .then("enrich", enrichRecord);   // Record -> Result<Enriched>
+//     ResultUtils::PipelineRun run = pipeline.run(lines, [&](Enriched && e) { store(e); });
+//
+// A record whose stage fails is dropped from its batch and reported with
+// its ResultException (see PipelineRun::failures and onFailure); the other
+// records carry on. Each stage receives its records as rvalues.
+//
+// With PipelineOptions::concurrent set, every stage runs on a thread of its
+// own, connected by bounded queues of batches. The sink and any
+// failure handler are then called from the stage threads: the sink only
+// from the last one, the failure handler from all of them. Stage functions
+// report errors through their Result; an exception escaping one terminates.
+template<typename In, typename... Stages>
+class Pipeline {
+public:
+    using output_type = typename pipeline_detail::output_of<In, Stages...>::type;
+
+    explicit Pipeline(PipelineOptions options = PipelineOptions()) : options_(options) {}
+
+    // Appends a stage taking the current output type.
+    template<typename FN>
+    Pipeline<In, Stages..., pipeline_detail::stage<output_type, FN>> then(std::string name, FN fn) && {
+        using S = pipeline_detail::stage<output_type, FN>;
+        S added{std::move(name), std::move(fn), cxx14::make_unique<pipeline_detail::stage_counters>()};
+        Pipeline<In, Stages..., S> next(options_);
+        next.stages_ = std::tuple_cat(std::move(stages_), std::make_tuple(std::move(added)));
+        next.handler_ = std::move(handler_);
+        return next;
+    }
+
+    // Receives failures as they happen instead of collecting them in the
+    // PipelineRun. Must be thread-safe in concurrent mode.
+    Pipeline onFailure(std::function<void(const PipelineFailure &)> handler) && {
+        handler_ = std::move(handler);
+        return std::move(*this);
+    }
+
+    void onFailure(std::function<void(const PipelineFailure &)> handler) & {
+        handler_ = std::move(handler);
+    }
+
+    static constexpr std::size_t stageCount() {
+        return sizeof...(Stages);
+    }
+
+    // Feeds every element of range through the stages, passing each
+    // surviving record to sink(output_type&&). Returns once every record has
+    // been delivered or failed. If reading or copying range throws, the
+    // records already fed are finished first and the exception then
+    // propagates.
+    template<typename R, typename Sink>
+    PipelineRun run(const R & range, Sink sink) {
+        static_assert(sizeof...(Stages) > 0, "a pipeline needs at least one stage");
+        return runStages(range, sink, std::index_sequence_for<Stages...>());
+    }
+
+    std::vector<StageStats> stats() const {
+        std::vector<StageStats> out;
+        collectStats(out, std::index_sequence_for<Stages...>());
+        return out;
+    }
+
+private:
+    template<typename, typename...> friend class Pipeline;
+
+    static constexpr std::size_t N = sizeof...(Stages);
+
+    template<std::size_t I>
+    using stage_at = typename std::tuple_element<I, std::tuple<Stages...>>::type;
+
+    template<std::size_t... Is>
+    void collectStats(std::vector<StageStats> & out, std::index_sequence<Is...>) const {
+        int expand[] = {0, (out.push_back(statsOf(std::get<Is>(stages_))), 0)...};
+        (void)expand;
+    }
+
+    template<typename S>
+    static StageStats statsOf(const S & s) {
+        const pipeline_detail::stage_counters & c = *s.counters;
+        return StageStats{s.name,
+                          c.batches.load(std::memory_order_relaxed),
+                          c.recordsIn.load(std::memory_order_relaxed),
+                          c.recordsOut.load(std::memory_order_relaxed),
+                          c.failures.load(std::memory_order_relaxed),
+                          std::chrono::nanoseconds(c.busyNanos.load(std::memory_order_relaxed)),
+                          std::chrono::nanoseconds(c.slowestNanos.load(std::memory_order_relaxed))};
+    }
+
+    // Splits range into batches, handing each to emit; the final batch is
+    // marked last (and is empty if range is).
+    template<typename R, typename Emit>
+    std::size_t feed(const R & range, Emit emit) const {
+        std::size_t size = std::max<std::size_t>(options_.batchSize, 1);
+        std::size_t count = 0;
+        pipeline_detail::batch<In> b;
+        for(const auto & item : range) {
+            if(b.items.size() == size) {
+                emit(std::move(b));
+                b = pipeline_detail::batch<In>();
+            }
+            if(b.items.empty()) {
+                b.items.reserve(size);
+                b.ids.reserve(size);
+            }
+            b.items.push_back(item);
+            b.ids.push_back(count++);
+        }
+        b.last = true;
+        emit(std::move(b));
+        return count;
+    }
+
+    template<typename Sink, typename B>
+    static std::size_t deliver(Sink & sink, B && b) {
+        for(auto & item : b.items)
+            sink(std::move(item));
+        return b.items.size();
+    }
+
+    template<typename R, typename Sink, std::size_t... Is>
+    PipelineRun runStages(const R & range, Sink & sink, std::index_sequence<Is...> is) {
+        std::vector<pipeline_detail::failure_log> logs(N);
+        for(pipeline_detail::failure_log & log : logs)
+            log.handler = &handler_;
+        PipelineRun result{0, 0, {}};
+        if(options_.concurrent)
+            runConcurrent(range, sink, logs, result, is);
+        else
+            result.recordsIn = feed(range, [&](pipeline_detail::batch<In> && b) {
+                result.delivered += flow<0>(std::move(b), sink, logs, std::true_type());
+            });
+        for(pipeline_detail::failure_log & log : logs)
+            result.failures.insert(result.failures.end(),
+                                   std::make_move_iterator(log.failures.begin()),
+                                   std::make_move_iterator(log.failures.end()));
+        std::sort(result.failures.begin(), result.failures.end(),
+                  [](const PipelineFailure & a, const PipelineFailure & b) { return a.record < b.record; });
+        return result;
+    }
+
+    // Sequential mode: one batch through stage I and everything after it.
+    template<std::size_t I, typename B, typename Sink>
+    std::size_t flow(B && b, Sink & sink, std::vector<pipeline_detail::failure_log> & logs, std::true_type) {
+        auto out = std::get<I>(stages_).process(I, std::move(b), logs[I]);
+        return flow<I + 1>(std::move(out), sink, logs, std::integral_constant<bool, I + 1 < N>());
+    }
+
+    template<std::size_t I, typename B, typename Sink>
+    std::size_t flow(B && b, Sink & sink, std::vector<pipeline_detail::failure_log> &, std::false_type) {
+        return deliver(sink, std::move(b));
+    }
+
+    template<typename R, typename Sink, std::size_t... Is>
+    void runConcurrent(const R & range, Sink & sink, std::vector<pipeline_detail::failure_log> & logs,
+                       PipelineRun & result, std::index_sequence<Is...>) {
+        // Queue I feeds stage I.
+        auto queues = std::make_tuple(cxx14::make_unique<pipeline_detail::spsc_queue<
+            pipeline_detail::batch<typename stage_at<Is>::input_type>>>(options_.queueCapacity)...);
+        std::size_t delivered = 0;
+        std::vector<std::thread> threads;
+        threads.reserve(N);
+        bool closed = false;
+        {
+            // Joins the stage threads however feed() leaves. If it throws
+            // before the last batch, an empty last batch winds them down.
+            struct join_guard {
+                std::vector<std::thread> & threads;
+                pipeline_detail::spsc_queue<pipeline_detail::batch<In>> & input;
+                bool & closed;
+
+                ~join_guard() {
+                    if(!closed && !threads.empty()) {
+                        pipeline_detail::batch<In> end;
+                        end.last = true;
+                        input.push(std::move(end));
+                    }
+                    for(std::thread & t : threads)
+                        t.join();
+                }
+            } guard{threads, *std::get<0>(queues), closed};
+
+            int expand[] = {0, (threads.emplace_back([&] {
+                stageLoop<Is>(queues, sink, logs[Is], delivered, std::integral_constant<bool, Is + 1 < N>());
+            }), 0)...};
+            (void)expand;
+            result.recordsIn = feed(range, [&](pipeline_detail::batch<In> && b) {
+                bool last = b.last;
+                std::get<0>(queues)->push(std::move(b));
+                closed = last;
+            });
+        }
+        result.delivered = delivered;
+    }
+
+    template<std::size_t I, typename Queues, typename Sink>
+    void stageLoop(Queues & queues, Sink &, pipeline_detail::failure_log & log, std::size_t &, std::true_type) {
+        while(true) {
+            auto out = std::get<I>(stages_).process(I, std::get<I>(queues)->pop(), log);
+            bool last = out.last;
+            std::get<I + 1>(queues)->push(std::move(out));
+            if(last)
+                return;
+        }
+    }
+
+    template<std::size_t I, typename Queues, typename Sink>
+    void stageLoop(Queues & queues, Sink & sink, pipeline_detail::failure_log & log, std::size_t & delivered, std::false_type) {
+        while(true) {
+            auto out = std::get<I>(stages_).process(I, std::get<I>(queues)->pop(), log);
+            delivered += deliver(sink, out);
+            if(out.last)
+                return;
+        }
+    }
+
+    PipelineOptions options_;
+    std::tuple<Stages...> stages_;
+    std::function<void(const PipelineFailure &)> handler_;
+};
+
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cxxutils/optional.hpp"
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_aggregate.hpp"
+#include "cxxutils/small_vector.hpp"
+
+// Accumulating validation. Where flatmap stops at the first failure, a
+// Validated collects every failure of a set of independent checks:
+//
+//     ResultUtils::Validated<Order> order = ResultUtils::combine(
+//         [](std::string id, int quantity) { return Order{id, quantity}; },
+//         parse_id(fields[0]),           // Result<std::string>
+//         parse_quantity(fields[1]));    // Result<int>
+//     Result<Order> r = std::move(order).toResult();
+//
+// The errors are kept in a SmallVector, so no allocation is made until
+// there are more than N of them.
+
+namespace ResultUtils {
+
+template<typename T, typename E = ResultException, std::size_t N = 4>
+class Validated {
+public:
+    using value_type = T;
+    using error_type = E;
+    using errors_type = cxxutils::SmallVector<E, N>;
+    static constexpr std::size_t inline_errors = N;
+
+    CXXUTILS_NODISCARD static Validated valid(const T & value) {
+        Validated v;
+        v.value_.emplace(value);
+        return v;
+    }
+
+    CXXUTILS_NODISCARD static Validated valid(T && value) {
+        Validated v;
+        v.value_.emplace(std::move(value));
+        return v;
+    }
+
+    CXXUTILS_NODISCARD static Validated invalid(E error) {
+        Validated v;
+        v.errors_.push_back(std::move(error));
+        return v;
+    }
+
+    // errors must not be empty.
+    CXXUTILS_NODISCARD static Validated invalid(errors_type errors) {
+        Validated v;
+        v.errors_ = std::move(errors);
+        return v;
+    }
+
+    // Valid with r's value, or invalid with its error.
+    Validated(const Result<T, E> & r) {
+        if(r.isOK())
+            value_.emplace(r.getValue());
+        else
+            errors_.push_back(r.getException());
+    }
+
+    Validated(Result<T, E> && r) {
+        if(r.isOK())
+            value_.emplace(r.takeValue());
+        else
+            errors_.push_back(r.takeException());
+    }
+
+    bool isValid() const {
+        return errors_.empty();
+    }
+
+    // Throws MissingOptionalValue when invalid.
+    const T& getValue() const {
+        return value_.getValue();
+    }
+
+    T takeValue() {
+        return value_.takeValue();
+    }
+
+    // In the order they were found; empty when valid.
+    const errors_type& errors() const {
+        return errors_;
+    }
+
+    errors_type takeErrors() {
+        return std::move(errors_);
+    }
+
+    // The value, or the errors combined by result_error_aggregator. A single
+    // error is passed on as it is.
+    Result<T, E> toResult() const & {
+        if(isValid())
+            return Result<T, E>::ok(value_.getValue());
+        if(errors_.size() == 1)
+            return Result<T, E>::failed(errors_.front());
+        return Result<T, E>::failed(result_error_aggregator<E>::aggregate(std::vector<E>(errors_.begin(), errors_.end())));
+    }
+
+    Result<T, E> toResult() && {
+        if(isValid())
+            return Result<T, E>::ok(value_.takeValue());
+        if(errors_.size() == 1)
+            return Result<T, E>::failed(std::move(errors_.front()));
+        std::vector<E> all;
+        all.reserve(errors_.size());
+        for(E & e : errors_)
+            all.push_back(std::move(e));
+        return Result<T, E>::failed(result_error_aggregator<E>::aggregate(std::move(all)));
+    }
+
+private:
+    Validated() = default;
+
+    // Engaged exactly when errors_ is empty.
+    optional<T> value_;
+    errors_type errors_;
+};
+
+namespace validated_detail {
+
+template<typename T, typename E, std::size_t N>
+Validated<T, E, N> as_validated(Validated<T, E, N> && v) {
+    return std::move(v);
+}
+
+template<typename T, typename E, std::size_t N>
+Validated<T, E, N> as_validated(const Validated<T, E, N> & v) {
+    return v;
+}
+
+template<typename T, typename E>
+Validated<T, E> as_validated(Result<T, E> && r) {
+    return Validated<T, E>(std::move(r));
+}
+
+template<typename T, typename E>
+Validated<T, E> as_validated(const Result<T, E> & r) {
+    return Validated<T, E>(r);
+}
+
+template<typename X>
+using validated_t = decltype(as_validated(std::declval<X>()));
+
+template<typename ERRORS, typename U>
+void collect(ERRORS & errors, Result<U, typename ERRORS::value_type> && r) {
+    if(!r.isOK())
+        errors.push_back(r.takeException());
+}
+
+template<typename OUT, typename FN, typename... VS>
+OUT combine(FN & fn, VS... vs) {
+    typename OUT::errors_type errors;
+    int expand[] = {0, (errors.append(vs.takeErrors()), 0)...};
+    (void)expand;
+    if(!errors.empty())
+        return OUT::invalid(std::move(errors));
+    return OUT::valid(fn(vs.takeValue()...));
+}
+
+}
+
+// Runs every check on value and keeps all of their failures. A check takes
+// const T& and returns a Result with any value type, often Result<void, E>.
+template<typename T, typename CHECK, typename... CHECKS>
+auto validate(T value, CHECK check, CHECKS... checks)
+    -> Validated<T, typename decltype(check(std::declval<const T&>()))::error_type> {
+    using OUT = Validated<T, typename decltype(check(std::declval<const T&>()))::error_type>;
+    typename OUT::errors_type errors;
+    const T & v = value;
+    int expand[] = {(validated_detail::collect(errors, check(v)), 0), (validated_detail::collect(errors, checks(v)), 0)...};
+    (void)expand;
+    if(!errors.empty())
+        return OUT::invalid(std::move(errors));
+    return OUT::valid(std::move(value));
+}
+
+// fn applied to the values of all the inputs if every one is valid,
+// otherwise every input's errors, in argument order. Inputs are Validated
+// or Result, all with the same error type; the output keeps as many errors
+// inline as the first input.
+template<typename FN, typename INPUT, typename... INPUTS>
+auto combine(FN fn, INPUT && input, INPUTS&&... inputs)
+    -> Validated<decltype(fn(std::declval<typename validated_detail::validated_t<INPUT>::value_type>(),
+                             std::declval<typename validated_detail::validated_t<INPUTS>::value_type>()...)),
+                 typename validated_detail::validated_t<INPUT>::error_type,
+                 validated_detail::validated_t<INPUT>::inline_errors> {
+    using FIRST = validated_detail::validated_t<INPUT>;
+    using OUT = Validated<decltype(fn(std::declval<typename FIRST::value_type>(),
+                                      std::declval<typename validated_detail::validated_t<INPUTS>::value_type>()...)),
+                          typename FIRST::error_type, FIRST::inline_errors>;
+    return validated_detail::combine<OUT>(fn, validated_detail::as_validated(std::forward<INPUT>(input)),
+                                          validated_detail::as_validated(std::forward<INPUTS>(inputs))...);
+}
+
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cxxutils {
+
+// A vector that keeps its first N elements inside the object and only
+// allocates once it grows past them. Meant for short lists that are
+// usually empty or nearly so, such as the errors of a validation.
+template<typename T, std::size_t N>
+class SmallVector {
+    static_assert(N > 0, "SmallVector needs room for at least one inline element");
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() : data_(inlineData()), size_(0), capacity_(N) {}
+
+    SmallVector(std::initializer_list<T> values) : SmallVector() {
+        reserve(values.size());
+        for(const T & v : values)
+            push_back(v);
+    }
+
+    SmallVector(const SmallVector & o) : SmallVector() {
+        reserve(o.size_);
+        for(const T & v : o)
+            push_back(v);
+    }
+
+    SmallVector(SmallVector && o) noexcept(std::is_nothrow_move_constructible<T>::value) : SmallVector() {
+        steal(o);
+    }
+
+    SmallVector& operator=(const SmallVector & o) {
+        if(this != &o) {
+            clear();
+            reserve(o.size_);
+            for(const T & v : o)
+                push_back(v);
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector && o) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        if(this != &o) {
+            clear();
+            release();
+            steal(o);
+        }
+        return *this;
+    }
+
+    ~SmallVector() {
+        clear();
+        release();
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    std::size_t capacity() const {
+        return capacity_;
+    }
+
+    // Whether the elements are still in the inline buffer.
+    bool isInline() const {
+        return data_ == inlineData();
+    }
+
+    T& operator[](std::size_t i) {
+        return data_[i];
+    }
+
+    const T& operator[](std::size_t i) const {
+        return data_[i];
+    }
+
+    T& front() {
+        return data_[0];
+    }
+
+    const T& front() const {
+        return data_[0];
+    }
+
+    T& back() {
+        return data_[size_ - 1];
+    }
+
+    const T& back() const {
+        return data_[size_ - 1];
+    }
+
+    iterator begin() {
+        return data_;
+    }
+
+    iterator end() {
+        return data_ + size_;
+    }
+
+    const_iterator begin() const {
+        return data_;
+    }
+
+    const_iterator end() const {
+        return data_ + size_;
+    }
+
+    void push_back(const T & v) {
+        emplace_back(v);
+    }
+
+    void push_back(T && v) {
+        emplace_back(std::move(v));
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+        if(size_ == capacity_) {
+            // Constructed before moving, in case args refer to an element.
+            T value(std::forward<Args>(args)...);
+            grow(capacity_ * 2);
+            return *::new (data_ + size_++) T(std::move(value));
+        }
+        return *::new (data_ + size_++) T(std::forward<Args>(args)...);
+    }
+
+    void pop_back() {
+        data_[--size_].~T();
+    }
+
+    // Appends the elements of o, moving them.
+    template<std::size_t M>
+    void append(SmallVector<T, M> && o) {
+        reserve(size_ + o.size());
+        for(T & v : o)
+            push_back(std::move(v));
+        o.clear();
+    }
+
+    template<std::size_t M>
+    void append(const SmallVector<T, M> & o) {
+        reserve(size_ + o.size());
+        for(const T & v : o)
+            push_back(v);
+    }
+
+    void reserve(std::size_t n) {
+        if(n > capacity_)
+            grow(std::max(n, capacity_ * 2));
+    }
+
+    void clear() {
+        for(std::size_t i = 0; i < size_; ++i)
+            data_[i].~T();
+        size_ = 0;
+    }
+
+private:
+    T* inlineData() {
+        return reinterpret_cast<T*>(inline_);
+    }
+
+    const T* inlineData() const {
+        return reinterpret_cast<const T*>(inline_);
+    }
+
+    void grow(std::size_t n) {
+        T* bigger = static_cast<T*>(::operator new(n * sizeof(T)));
+        for(std::size_t i = 0; i < size_; ++i) {
+            ::new (bigger + i) T(std::move(data_[i]));
+            data_[i].~T();
+        }
+        release();
+        data_ = bigger;
+        capacity_ = n;
+    }
+
+    // Frees heap storage; the elements must already be destroyed.
+    void release() {
+        if(!isInline())
+            ::operator delete(data_);
+        data_ = inlineData();
+        capacity_ = N;
+    }
+
+    // Takes o's elements, leaving it empty. Called with this empty and inline.
+    void steal(SmallVector & o) {
+        if(o.isInline()) {
+            for(std::size_t i = 0; i < o.size_; ++i)
+                ::new (data_ + i) T(std::move(o.data_[i]));
+            size_ = o.size_;
+            o.clear();
+            return;
+        }
+        data_ = o.data_;
+        size_ = o.size_;
+        capacity_ = o.capacity_;
+        o.data_ = o.inlineData();
+        o.size_ = 0;
+        o.capacity_ = N;
+    }
+
+    alignas(T) unsigned char inline_[sizeof(T) * N];
+    T* data_;
+    std::size_t size_;
+    std::size_t capacity_;
+};
+
+}
@@ -13,7 +13,7 @@ public:
     std::string
     describe_failure(const Result<T> & result) const {
         std::stringstream ss;
-        ss<<"expected valid result but got failed with '" << result.getException().mesg<<"'";
+        ss<<"expected valid result but got failed with '" << result.getException().mesg()<<"'";
         return ss.str();
     }
 };
@@ -46,7 +46,7 @@ public:
     std::string
     describe_failure(const Result<U> & result) const {
         if(!result.isOK())
-          return "expected valid result but got failed result with '"+result.getException().mesg+"'";
+          return "expected valid result but got failed result with '"+std::string(result.getException().mesg())+"'";
         return "Expected Result with value satisfying : " + 
                 comparator.describe_failure(result.getValue());
     }
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cxxutils/failure_handler.hpp"
+
+namespace cxxutils {
+
+// A fixed-size thread pool where every worker owns a task deque. Workers pop
+// their own tasks LIFO and steal from the other end of their siblings'
+// deques when they run dry. Tasks submitted from a worker go to that
+// worker's own deque.
+//
+// Tasks should not throw. One that does has its exception dropped, so it
+// cannot take down a worker or unwind a thread helping out via tryRunOne;
+// tasks that need to report a failure catch it themselves.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t threads = defaultThreadCount()) :
+        queues(std::max<std::size_t>(threads, 1)) {
+        for(std::size_t i = 0; i < queues.size(); ++i)
+            queues[i].reset(new Queue());
+        workers.reserve(queues.size());
+        for(std::size_t i = 0; i < queues.size(); ++i)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCv.notify_all();
+        for(std::thread & t : workers)
+            t.join();
+    }
+
+    std::size_t size() const {
+        return queues.size();
+    }
+
+    void submit(std::function<void()> task) {
+        std::size_t index = (currentPool() == this)
+            ? currentWorker()
+            : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        pending.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        sleepCv.notify_one();
+    }
+
+    // Runs one queued task on the calling thread, if there is one. Threads
+    // waiting on pool work can call this to help instead of blocking.
+    bool tryRunOne() {
+        std::function<void()> task;
+        std::size_t home = (currentPool() == this) ? currentWorker() : 0;
+        if(!takeTask(home, task))
+            return false;
+        run(task);
+        return true;
+    }
+
+    static WorkStealingPool& global() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    static std::size_t defaultThreadCount() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static WorkStealingPool*& currentPool() {
+        static thread_local WorkStealingPool* pool = nullptr;
+        return pool;
+    }
+
+    static std::size_t& currentWorker() {
+        static thread_local std::size_t index = 0;
+        return index;
+    }
+
+    static void run(std::function<void()> & task) {
+#ifdef CXXUTILS_NO_EXCEPTIONS
+        task();
+#else
+        try {
+            task();
+        } catch(...) {
+        }
+#endif
+    }
+
+    bool takeTask(std::size_t home, std::function<void()> & task) {
+        {
+            Queue & own = *queues[home];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        for(std::size_t offset = 1; offset < queues.size(); ++offset) {
+            Queue & victim = *queues[(home + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(std::size_t index) {
+        currentPool() = this;
+        currentWorker() = index;
+        std::function<void()> task;
+        while(true) {
+            if(takeTask(index, task)) {
+                run(task);
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCv.wait(lock, [this] {
+                return stopping || pending.load(std::memory_order_acquire) > 0;
+            });
+            if(stopping && pending.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> nextQueue{0};
+    std::atomic<std::size_t> pending{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool stopping = false;
+};
+
+}
@@ -0,0 +1,76 @@
+#include "cxxutils/arena.hpp"
+#include "cxxutils/result.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+
+using ArenaVector = std::vector<int, cxxutils::ArenaAllocator<int>>;
+
+TEST(Arena, AllocationsAreAligned) {
+    cxxutils::MonotonicArena arena(256);
+    for(int i = 0; i < 100; ++i) {
+        void* p = arena.allocate(i + 1, 16);
+        assertThat(reinterpret_cast<std::uintptr_t>(p) % 16, is(0u));
+    }
+    arena.reset();
+    assertThat(arena.bytesUsed(), is(0u));
+}
+
+TEST(Arena, ErrorPayloadsComeFromTheArena) {
+    cxxutils::MonotonicArena arena;
+    cxxutils::ArenaAllocator<char> alloc(arena);
+    {
+        Result<int> r = make_result_failed<int>(std::allocator_arg, alloc, ResultComponent("db"),
+                                                "a message long enough to defeat small string optimisation");
+        Result<int> copy = r;
+        assertThat(copy, isFailedResult());
+        assertThat(std::string(copy.getException().mesg()),
+                   is(std::string("a message long enough to defeat small string optimisation")));
+        assertThat(arena.bytesUsed() > 0, is(true));
+    }
+    arena.reset();
+}
+
+TEST(Arena, ValuesUseUsesAllocatorConstruction) {
+    cxxutils::MonotonicArena arena;
+    cxxutils::ArenaAllocator<char> alloc(arena);
+    Result<ArenaVector> r = make_result_ok<ArenaVector>(std::allocator_arg, alloc, 5, 1);
+    assertThat(r, isValidResult());
+    assertThat(r.getValue().size(), is(5u));
+    assertThat(arena.bytesUsed() >= 5 * sizeof(int), is(true));
+}
+
+TEST(Arena, ReleasedPayloadsAreNoLongerLive) {
+    cxxutils::MonotonicArena arena;
+    cxxutils::ArenaAllocator<char> alloc(arena);
+    {
+        Result<int> r = make_result_failed<int>(std::allocator_arg, alloc, ResultComponent("db"), "refused");
+        assertThat(r, isFailedResult());
+        Result<int> copy = r;
+        assertThat(arena.liveAllocations(), is(1u));
+    }
+    assertThat(arena.liveAllocations(), is(0u));
+    arena.reset();
+}
+
+#ifndef NDEBUG
+TEST(ArenaDeathTest, ResetWithAnEscapedPayload) {
+    EXPECT_DEATH({
+        cxxutils::MonotonicArena arena;
+        cxxutils::ArenaAllocator<char> alloc(arena);
+        ResultException escaped = ResultException(std::allocator_arg, alloc, ResultComponent("db"), "refused");
+        arena.reset();
+    }, "allocations are live");
+}
+#endif
+
+TEST(Arena, OversizedRequestsThrow) {
+    cxxutils::MonotonicArena arena;
+    EXPECT_THROW(arena.allocate(std::numeric_limits<std::size_t>::max() - 8), std::bad_alloc);
+    cxxutils::ArenaAllocator<double> alloc(arena);
+    EXPECT_THROW(alloc.allocate(std::numeric_limits<std::size_t>::max() / 2), std::bad_array_new_length);
+    assertThat(arena.allocate(16) != nullptr, is(true));
+}
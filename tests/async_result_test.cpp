@@ -0,0 +1,125 @@
+#include "cxxutils/async_result.hpp"
+#include "cxxutils/thread_pool.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class FetchErrc { none, broken, timeout };
+
+}
+
+template<>
+struct async_error<FetchErrc> {
+    static FetchErrc make(const char *) {
+        return FetchErrc::broken;
+    }
+};
+
+TEST(AsyncResult, ChainsAcrossThreads) {
+    cxxutils::WorkStealingPool pool(2);
+    AsyncPromise<int> promise;
+    AsyncResult<std::string> chained = promise.getResult()
+        .map([](int x) { return x * 2; }, pool)
+        .flatmap([](int x) { return Result<std::string>::ok(std::to_string(x)); });
+    std::thread producer([&] { promise.setResult(Result<int>::ok(21)); });
+    Result<std::string> r = std::move(chained).get();
+    producer.join();
+    assertThat(r, isResultWhereValue(is(std::string("42"))));
+}
+
+TEST(AsyncResult, FlatmapToAsync) {
+    Result<int> r = AsyncResult<int>::ready(Result<int>::ok(1))
+        .flatmap([](int x) { return AsyncResult<int>::ready(Result<int>::ok(x + 1)); })
+        .get();
+    assertThat(r, isResultWhereValue(is(2)));
+}
+
+TEST(AsyncResult, OnFailurePassesTheResultOn) {
+    bool seen = false;
+    Result<int> r = AsyncResult<int>::ready(make_result_failed<int>("c", "m"))
+        .on_failure([&](const ResultException &) { seen = true; })
+        .get();
+    assertThat(seen, is(true));
+    assertThat(r, isFailedResult());
+}
+
+TEST(AsyncResult, WhenAllAggregatesFailures) {
+    std::vector<AsyncPromise<int>> promises(4);
+    std::vector<AsyncResult<int>> inputs;
+    for(auto & p : promises)
+        inputs.push_back(p.getResult());
+    AsyncResult<std::vector<int>> all = when_all(std::move(inputs));
+    std::vector<std::thread> producers;
+    for(int i = 0; i < 4; ++i) {
+        producers.emplace_back([&, i] {
+            promises[i].setResult(i % 2 == 1 ? make_result_failed<int>("c", "e" + std::to_string(i))
+                                             : Result<int>::ok(i));
+        });
+    }
+    for(std::thread & t : producers)
+        t.join();
+    Result<std::vector<int>> r = std::move(all).get();
+    assertThat(r, isFailedResult());
+    assertThat(std::string(r.getException().mesg()), is(std::string("2 failures; c: e1; c: e3")));
+}
+
+TEST(AsyncResult, WhenAllSucceeds) {
+    std::vector<AsyncResult<int>> inputs;
+    inputs.push_back(AsyncResult<int>::ready(Result<int>::ok(1)));
+    inputs.push_back(AsyncResult<int>::ready(Result<int>::ok(2)));
+    assertThat(when_all(std::move(inputs)).get(), isResultWhereValue(is(std::vector<int>{1, 2})));
+}
+
+TEST(AsyncResult, WhenAnyTakesFirstSuccess) {
+    std::vector<AsyncResult<int>> inputs;
+    inputs.push_back(AsyncResult<int>::ready(make_result_failed<int>("c", "m")));
+    inputs.push_back(AsyncResult<int>::ready(Result<int>::ok(7)));
+    assertThat(when_any(std::move(inputs)).get(), isResultWhereValue(is(7)));
+}
+
+TEST(AsyncResult, BrokenPromiseFailsTheResult) {
+    AsyncResult<int> dropped = [] {
+        AsyncPromise<int> promise;
+        return promise.getResult();
+    }();
+    Result<int> r = std::move(dropped).get();
+    assertThat(r, isFailedResult());
+    assertThat(std::string(r.getException().mesg()), is(std::string("broken promise")));
+
+    AsyncPromise<int> promise;
+    AsyncResult<int> chained = promise.getResult().map([](int x) { return x + 1; });
+    std::thread([copy = promise]() mutable {}).join();
+    assertThat(chained.isReady(), is(false));
+    promise = AsyncPromise<int>();
+    assertThat(std::move(chained).get(), isFailedResult());
+}
+
+TEST(AsyncResult, PromiseSetByACopyIsNotBroken) {
+    AsyncPromise<int> promise;
+    AsyncResult<int> result = promise.getResult();
+    std::thread([copy = promise]() mutable { copy.setResult(Result<int>::ok(3)); }).join();
+    promise = AsyncPromise<int>();
+    assertThat(std::move(result).get(), isResultWhereValue(is(3)));
+}
+
+TEST(AsyncResult, WhenAnyOfNothingFails) {
+    AsyncResult<int> any = when_any(std::vector<AsyncResult<int>>());
+    assertThat(any.isReady(), is(true));
+    Result<int> r = std::move(any).get();
+    assertThat(r, isFailedResult());
+    assertThat(std::string(r.getException().mesg()), is(std::string("when_any of no inputs")));
+}
+
+TEST(AsyncResult, BrokenPromiseUsesTheSpecializedError) {
+    AsyncResult<int, FetchErrc> dropped = [] {
+        AsyncPromise<int, FetchErrc> promise;
+        return promise.getResult();
+    }();
+    Result<int, FetchErrc> r = std::move(dropped).get();
+    ASSERT_FALSE(r.isOK());
+    ASSERT_TRUE(r.getException() == FetchErrc::broken);
+}
@@ -0,0 +1,104 @@
+// Built with -fno-exceptions: every header must compile, and failed
+// accesses go through the cxxutils failure handler instead of throwing.
+#include "cxxutils/arena.hpp"
+#include "cxxutils/async_result.hpp"
+#include "cxxutils/object_pool.hpp"
+#include "cxxutils/optional.hpp"
+#include "cxxutils/optional_column.hpp"
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_aggregate.hpp"
+#include "cxxutils/result_backtrace.hpp"
+#include "cxxutils/result_batch.hpp"
+#include "cxxutils/result_coroutine.hpp"
+#include "cxxutils/result_deadline.hpp"
+#include "cxxutils/result_lazy.hpp"
+#include "cxxutils/result_memo.hpp"
+#include "cxxutils/result_metrics.hpp"
+#include "cxxutils/result_parallel.hpp"
+#include "cxxutils/result_parse.hpp"
+#include "cxxutils/result_pipeline.hpp"
+#include "cxxutils/result_validated.hpp"
+#include "cxxutils/small_vector.hpp"
+#include "cxxutils/thread_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifndef CXXUTILS_NO_EXCEPTIONS
+#error "this test must be built with exceptions disabled"
+#endif
+
+namespace {
+
+void exitWithWhat(const char * what) {
+    std::fprintf(stderr, "handled: %s\n", what);
+    std::_Exit(3);
+}
+
+Result<int> half(int x) {
+    if(x % 2 != 0)
+        return make_result_failed<int>("half", "odd input");
+    return Result<int>::ok(x / 2);
+}
+
+Result<int> quarter(int x) {
+    int h = co_await half(x);
+    co_return co_await half(h);
+}
+
+}
+
+TEST(NoExceptions, SuccessfulAccessIsUnaffected) {
+    optional<int> o(3);
+    EXPECT_EQ(o.getValue(), 3);
+    EXPECT_EQ(Result<int>::ok(4).getValueOrThrow(), 4);
+    EXPECT_EQ(quarter(8).getValueOrThrow(), 2);
+    EXPECT_FALSE(quarter(6).isOK());
+    std::vector<int> in{2, 4, 6};
+    EXPECT_TRUE(ResultUtils::traverse(in, half).isOK());
+    EXPECT_EQ(cxxutils::make_pooled_unique<int>(5).operator*(), 5);
+}
+
+TEST(NoExceptions, NewerHeadersInstantiate) {
+    cxxutils::MemoCache<int, int> cache;
+    EXPECT_EQ(cache.get(8, half).getValueOrThrow(), 4);
+    auto pipeline = ResultUtils::Pipeline<int>().then("half", half);
+    EXPECT_EQ(pipeline.run(std::vector<int>{2, 3, 4}, [](int) {}).delivered, 2u);
+    EXPECT_EQ(ResultUtils::validate(4, half, half).isValid(), true);
+    EXPECT_EQ(ResultUtils::flatmap(Result<int>::ok(8), cxxutils::CancellationToken(), half, half).getValueOrThrow(), 2);
+    cxxutils::SmallVector<int, 2> small{1, 2, 3};
+    EXPECT_EQ(small.size(), 3u);
+    cxxutils::OptionalColumn<int> column(std::vector<optional<int>>{optional<int>(1), optional<int>()});
+    EXPECT_EQ(column.countValid(), 1u);
+    EXPECT_EQ(cxxutils::parse_number<int>("12").getValueOrThrow(), 12);
+}
+
+TEST(NoExceptionsDeathTest, EmptyOptionalAbortsByDefault) {
+    optional<int> o;
+    EXPECT_DEATH(o.getValue(), "getValue called on an empty optional");
+}
+
+TEST(NoExceptionsDeathTest, ReportsTheAccessorCalled) {
+    optional<int> o;
+    EXPECT_DEATH(o.takeValue(), "takeValue called on an empty optional");
+    int x = 1;
+    optional<int&> ref(x);
+    ref.takeValue();
+    EXPECT_DEATH(ref.takeValue(), "takeValue called on an empty optional");
+}
+
+TEST(NoExceptionsDeathTest, FailedResultReportsTheError) {
+    Result<int> r = make_result_failed<int>("db", "refused");
+    ASSERT_FALSE(r.isOK());
+    EXPECT_DEATH(r.getValueOrThrow(), "getValueOrThrow called on a failed Result: db: refused");
+}
+
+TEST(NoExceptionsDeathTest, CustomHandler) {
+    EXPECT_EXIT({
+        cxxutils::setFailureHandler(&exitWithWhat);
+        optional<int>().getValue();
+    }, ::testing::ExitedWithCode(3), "handled: getValue called on an empty optional");
+}
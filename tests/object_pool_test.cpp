@@ -0,0 +1,38 @@
+#include "cxxutils/object_pool.hpp"
+#include "cxxutils/result.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <string>
+
+namespace {
+
+struct Widget {
+    explicit Widget(int id_in) : id(id_in), name(std::to_string(id_in)) {}
+    int id;
+    std::string name;
+};
+
+}
+
+TEST(ObjectPool, ReusesReleasedStorage) {
+    cxxutils::PoolStats before = cxxutils::ObjectPool<Widget>::stats();
+    for(int i = 0; i < 100; ++i) {
+        Result<cxxutils::pooled_unique_ptr<Widget>> r = make_result_pooled_unique_ok<Widget>(i);
+        assertThat(r, isValidResult());
+        assertThat(r.getValue()->id, is(i));
+    }
+    cxxutils::PoolStats after = cxxutils::ObjectPool<Widget>::stats();
+    assertThat(after.hits + after.misses - before.hits - before.misses, is(100u));
+    assertThat(after.misses - before.misses <= 1, is(true));
+}
+
+TEST(ObjectPool, SharedVariantCountsUnderTheUserType) {
+    cxxutils::PoolStats before = cxxutils::ObjectPool<Widget>::stats();
+    for(int i = 0; i < 10; ++i) {
+        Result<std::shared_ptr<Widget>> r = make_result_pooled_shared_ok<Widget>(i);
+        assertThat(r, isValidResult());
+        assertThat(r.getValue()->name, is(std::to_string(i)));
+    }
+    cxxutils::PoolStats after = cxxutils::ObjectPool<Widget>::stats();
+    assertThat(after.hits + after.misses - before.hits - before.misses, is(10u));
+}
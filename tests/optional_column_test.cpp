@@ -0,0 +1,127 @@
+#include "cxxutils/optional_column.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using cxxutils::OptionalColumn;
+
+namespace {
+
+// Every third row missing, across several bitmap words and a partial one.
+std::vector<optional<int>> makeRows(std::size_t n) {
+    std::vector<optional<int>> rows;
+    for(std::size_t i = 0; i < n; ++i)
+        rows.push_back(i % 3 == 1 ? optional<int>() : optional<int>(static_cast<int>(i) - 50));
+    return rows;
+}
+
+}
+
+TEST(OptionalColumn, RoundTripsThroughOptionals) {
+    std::vector<optional<int>> rows = makeRows(150);
+    OptionalColumn<int> column(rows);
+    assertThat(column.size(), is(150u));
+    std::vector<optional<int>> back = column.toOptionals();
+    ASSERT_EQ(back.size(), rows.size());
+    for(std::size_t i = 0; i < rows.size(); ++i) {
+        assertThat(back[i].hasValue(), is(rows[i].hasValue()));
+        if(rows[i].hasValue()) {
+            assertThat(back[i].getValue(), is(rows[i].getValue()));
+        }
+    }
+}
+
+TEST(OptionalColumn, MissingRowsHoldZeroAndNoTrailingBits) {
+    OptionalColumn<int> column;
+    column.push_back(7);
+    column.pushMissing();
+    column.set(0, optional<int>());
+    assertThat(column.values()[0], is(0));
+    assertThat(column.values()[1], is(0));
+    assertThat(column.validity()[0], is(std::uint64_t(0)));
+}
+
+TEST(OptionalColumn, KernelsMatchARowByRowLoop) {
+    std::vector<optional<int>> rows = makeRows(1000);
+    OptionalColumn<int> column(rows);
+    int sum = 0;
+    int lo = 1 << 30;
+    int hi = -(1 << 30);
+    std::size_t valid = 0;
+    for(const optional<int> & row : rows) {
+        if(!row.hasValue())
+            continue;
+        ++valid;
+        sum += row.getValue();
+        lo = row.getValue() < lo ? row.getValue() : lo;
+        hi = row.getValue() > hi ? row.getValue() : hi;
+    }
+    assertThat(column.countValid(), is(valid));
+    assertThat(column.sum(), is(sum));
+    assertThat(column.min().getValue(), is(lo));
+    assertThat(column.max().getValue(), is(hi));
+}
+
+TEST(OptionalColumn, FloatingPointMinAndMaxSkipMissingRows) {
+    // Missing rows hold 0.0, below or above every present value here.
+    std::vector<optional<double>> rows;
+    for(std::size_t i = 0; i < 300; ++i)
+        rows.push_back(i % 7 == 2 ? optional<double>() : optional<double>(1.0 + static_cast<double>((i * 37) % 101)));
+    rows.push_back(optional<double>(-5.0));
+    OptionalColumn<double> doubles(rows);
+    assertThat(doubles.min().getValue(), is(-5.0));
+    assertThat(doubles.max().getValue(), is(101.0));
+
+    OptionalColumn<float> floats;
+    for(std::size_t i = 0; i < 300; ++i) {
+        if(i % 5 == 0)
+            floats.pushMissing();
+        else
+            floats.push_back(-1.0f - static_cast<float>(i));
+    }
+    assertThat(floats.min().getValue(), is(-300.0f));
+    assertThat(floats.max().getValue(), is(-2.0f));
+}
+
+TEST(OptionalColumn, MinAndMaxOfAnAllMissingColumnAreEmpty) {
+    OptionalColumn<double> column;
+    column.pushMissing();
+    column.pushMissing();
+    assertThat(column.min().hasValue(), is(false));
+    assertThat(column.max().hasValue(), is(false));
+    assertThat(column.sum(), is(0.0));
+}
+
+TEST(OptionalColumn, MinAndMaxIgnoreMissingZeros) {
+    OptionalColumn<double> column;
+    column.push_back(3.5);
+    column.pushMissing();
+    column.push_back(8.0);
+    assertThat(column.min().getValue(), is(3.5));
+    assertThat(column.max().getValue(), is(8.0));
+}
+
+TEST(OptionalColumn, FilterKeepsPresentRowsMatchingThePredicate) {
+    OptionalColumn<int> column(makeRows(200));
+    OptionalColumn<int> positive = column.filter([](int v) { return v > 0; });
+    std::vector<int> expected;
+    for(const optional<int> & row : makeRows(200)) {
+        if(row.hasValue() && row.getValue() > 0)
+            expected.push_back(row.getValue());
+    }
+    ASSERT_EQ(positive.size(), expected.size());
+    assertThat(positive.countValid(), is(expected.size()));
+    for(std::size_t i = 0; i < expected.size(); ++i)
+        assertThat(positive.get(i).getValue(), is(expected[i]));
+}
+
+TEST(OptionalColumn, FillMissingMakesEveryRowValid) {
+    OptionalColumn<int> column(makeRows(130));
+    column.fillMissing(-1);
+    assertThat(column.countValid(), is(130u));
+    assertThat(column.get(1).getValue(), is(-1));
+    assertThat(column.get(0).getValue(), is(-50));
+    column.push_back(4);
+    assertThat(column.countValid(), is(131u));
+}
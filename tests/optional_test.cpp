@@ -0,0 +1,112 @@
+#include "cxxutils/optional.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class Colour : unsigned char { Red, Green, Invalid = 255 };
+
+struct Price {
+    double value;
+};
+
+}
+
+template<>
+struct optional_niche<Colour> : optional_enum_niche<Colour, Colour::Invalid> {};
+
+template<>
+struct optional_niche<Price> : optional_nan_niche<Price> {};
+
+static_assert(std::is_trivially_copyable<optional<int>>::value, "trivial payloads stay trivial");
+static_assert(!std::is_trivially_copyable<optional<std::string>>::value, "");
+static_assert(sizeof(optional<int*>) == sizeof(int*), "pointers use a niche");
+static_assert(sizeof(optional<std::unique_ptr<int>>) == sizeof(int*), "unique_ptr uses a niche");
+static_assert(sizeof(optional<double>) > sizeof(double), "double keeps explicit storage");
+static_assert(sizeof(optional<Price>) == sizeof(double), "opted-in NaN niche");
+static_assert(sizeof(optional<Colour>) == sizeof(Colour), "enum niche");
+
+TEST(Optional, DefaultIsEmpty) {
+    optional<std::string> o;
+    assertThat(o.hasValue(), is(false));
+    EXPECT_THROW(o.getValue(), MissingOptionalValue);
+}
+
+TEST(Optional, CopyAndAssign) {
+    optional<std::string> a(std::string("hello"));
+    optional<std::string> b = a;
+    optional<std::string> c;
+    c = b;
+    assertThat(a.getValue(), is(std::string("hello")));
+    assertThat(c.getValue(), is(std::string("hello")));
+    c = optional<std::string>();
+    assertThat(c.hasValue(), is(false));
+}
+
+TEST(Optional, TakeValueEmptiesTheOptional) {
+    optional<std::unique_ptr<int>> o(std::unique_ptr<int>(new int(3)));
+    std::unique_ptr<int> p = o.takeValue();
+    assertThat(*p, is(3));
+    assertThat(o.hasValue(), is(false));
+}
+
+TEST(Optional, EmplaceAndReset) {
+    optional<std::vector<int>> o;
+    o.emplace(3, 7);
+    assertThat(o.getValue().size(), is(3u));
+    o.reset();
+    assertThat(o.hasValue(), is(false));
+}
+
+TEST(Optional, NicheNullPointerIsStillAValue) {
+    optional<int*> o(nullptr);
+    assertThat(o.hasValue(), is(true));
+    o.reset();
+    assertThat(o.hasValue(), is(false));
+}
+
+TEST(Optional, DoubleHoldsAnyNaN) {
+    const std::uint64_t bits = 0x7FF80000DEAD0001ULL;
+    double nan;
+    std::memcpy(&nan, &bits, sizeof(nan));
+    optional<double> o(nan);
+    assertThat(o.hasValue(), is(true));
+    o.reset();
+    assertThat(o.hasValue(), is(false));
+}
+
+TEST(Optional, NicheNaN) {
+    optional<Price> o(Price{1.5});
+    optional<Price> copy = o;
+    assertThat(copy.getValue().value, is(1.5));
+    copy.reset();
+    assertThat(copy.hasValue(), is(false));
+}
+
+TEST(Optional, NicheUniquePtrMoves) {
+    optional<std::unique_ptr<int>> a(std::unique_ptr<int>(new int(4)));
+    optional<std::unique_ptr<int>> b = std::move(a);
+    assertThat(*b.getValue(), is(4));
+    optional<std::unique_ptr<int>> c;
+    c = std::move(b);
+    assertThat(*c.getValue(), is(4));
+}
+
+TEST(Optional, NicheEnum) {
+    assertThat(optional<Colour>(Colour::Green).hasValue(), is(true));
+    assertThat(optional<Colour>().hasValue(), is(false));
+}
+
+TEST(Optional, Reference) {
+    int x = 3;
+    optional<int&> r(x);
+    r.getValue() = 4;
+    assertThat(x, is(4));
+    assertThat(&r.takeValue(), is(&x));
+    assertThat(r.hasValue(), is(false));
+}
@@ -0,0 +1,59 @@
+#include "cxxutils/result.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <string>
+
+namespace {
+
+struct BacktraceSettings : ::testing::Test {
+    ~BacktraceSettings() {
+        ResultBacktrace::setSampleRate(0);
+        ResultBacktrace::setAllEnabled(true);
+    }
+};
+
+ResultException fail(const ResultComponent & component) {
+    Result<int> r = make_result_failed<int>(component, "failed");
+    EXPECT_FALSE(r.isOK());
+    return r.getException();
+}
+
+}
+
+TEST_F(BacktraceSettings, OffByDefault) {
+    assertThat(ResultBacktrace::sampleRate(), is(0u));
+    assertThat(fail(ResultComponent("bt.default")).backtrace().empty(), is(true));
+}
+
+TEST_F(BacktraceSettings, CapturesWhenSampled) {
+    ResultBacktrace::setSampleRate(1);
+    ResultException e = fail(ResultComponent("bt.sampled"));
+    assertThat(e.backtrace().empty(), is(false));
+    assertThat(e.describe().find("\n  backtrace:\n    #0 ") != std::string::npos, is(true));
+
+    // Context added later does not hide the origin.
+    e.addContext("layer", "passing through");
+    ResultException shared = e;
+    shared.addContext("outer", "shared");
+    assertThat(shared.backtrace().size(), is(e.backtrace().size()));
+}
+
+TEST_F(BacktraceSettings, SamplesOneInN) {
+    ResultBacktrace::setSampleRate(4);
+    ResultComponent component("bt.rate");
+    int captured = 0;
+    for(int i = 0; i < 40; ++i)
+        captured += fail(component).backtrace().empty() ? 0 : 1;
+    assertThat(captured, is(10));
+}
+
+TEST_F(BacktraceSettings, ComponentMask) {
+    ResultBacktrace::setSampleRate(1);
+    ResultComponent quiet("bt.quiet");
+    ResultComponent loud("bt.loud");
+    ResultBacktrace::setAllEnabled(false);
+    ResultBacktrace::setEnabled(loud, true);
+    assertThat(ResultBacktrace::isEnabled(quiet), is(false));
+    assertThat(fail(quiet).backtrace().empty(), is(true));
+    assertThat(fail(loud).backtrace().empty(), is(false));
+}
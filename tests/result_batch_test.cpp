@@ -0,0 +1,63 @@
+#include "cxxutils/result_batch.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace ResultUtils;
+
+namespace {
+
+Result<int> evenOnly(int x) {
+    if(x % 2 != 0)
+        return make_result_failed<int>("evenOnly", std::to_string(x));
+    return Result<int>::ok(x);
+}
+
+}
+
+TEST(ResultBatch, CollectAllOk) {
+    std::vector<Result<int>> in;
+    in.push_back(Result<int>::ok(1));
+    in.push_back(Result<int>::ok(2));
+    assertThat(collect(std::move(in)), isResultWhereValue(is(std::vector<int>{1, 2})));
+}
+
+TEST(ResultBatch, CollectStopsAtFirstFailure) {
+    std::vector<Result<int>> in;
+    in.push_back(Result<int>::ok(1));
+    in.push_back(make_result_failed<int>("c", "first"));
+    in.push_back(make_result_failed<int>("c", "second"));
+    Result<std::vector<int>> r = collect(in);
+    assertThat(r, isFailedResult());
+    assertThat(std::string(r.getException().mesg()), is(std::string("first")));
+}
+
+TEST(ResultBatch, Partition) {
+    std::vector<Result<int>> in;
+    in.push_back(Result<int>::ok(1));
+    in.push_back(make_result_failed<int>("c", "m"));
+    in.push_back(Result<int>::ok(3));
+    auto parts = partition(std::move(in));
+    assertThat(parts.first, is(std::vector<int>{1, 3}));
+    assertThat(parts.second.size(), is(1u));
+}
+
+TEST(ResultBatch, TraverseShortCircuits) {
+    int calls = 0;
+    std::list<int> in{2, 3, 4};
+    Result<std::vector<int>> r = traverse(in, [&](int x) { ++calls; return evenOnly(x); });
+    assertThat(r, isFailedResult());
+    assertThat(calls, is(2));
+}
+
+TEST(ResultBatch, TraverseAllKeepsFailureIndices) {
+    std::vector<int> in{2, 3, 4, 5};
+    ResultBatch<int> batch = traverse_all(in, evenOnly);
+    assertThat(batch.values(), is(std::vector<int>{2, 4}));
+    assertThat(batch.failureCount(), is(2u));
+    assertThat(batch.failures()[0].index, is(1u));
+    assertThat(batch.failures()[1].index, is(3u));
+    assertThat(std::move(batch).toResult(), isFailedResult());
+}
@@ -0,0 +1,109 @@
+#include "cxxutils/optional.hpp"
+#include "cxxutils/result.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+// Everything here is checked at compile time; the TEST only keeps the file
+// visible in the test listing.
+
+namespace {
+
+enum class ConfigErrc { empty, bad_digit, out_of_range };
+
+struct ConfigError {
+    ConfigErrc code;
+    int position;
+};
+
+constexpr Result<int, ConfigError> parseInt(const char * text) {
+    if(*text == '\0')
+        return Result<int, ConfigError>::failed(ConfigError{ConfigErrc::empty, 0});
+    int value = 0;
+    for(int i = 0; text[i] != '\0'; ++i) {
+        if(text[i] < '0' || text[i] > '9')
+            return Result<int, ConfigError>::failed(ConfigError{ConfigErrc::bad_digit, i});
+        value = value * 10 + (text[i] - '0');
+    }
+    return Result<int, ConfigError>::ok(value);
+}
+
+constexpr Result<int, ConfigError> checkPort(int port) {
+    if(port < 1 || port > 65535)
+        return Result<int, ConfigError>::failed(ConfigError{ConfigErrc::out_of_range, 0});
+    return Result<int, ConfigError>::ok(port);
+}
+
+constexpr Result<int, ConfigError> parsePort(const char * text) {
+    return parseInt(text).flatmap(checkPort);
+}
+
+static_assert(parsePort("8080").isOK(), "");
+static_assert(parsePort("8080").getValue() == 8080, "");
+static_assert(!parsePort("80x0").isOK(), "");
+static_assert(parsePort("80x0").getException().code == ConfigErrc::bad_digit, "");
+static_assert(parsePort("80x0").getException().position == 2, "");
+static_assert(parsePort("99999").getException().code == ConfigErrc::out_of_range, "");
+static_assert(parsePort("").getException().code == ConfigErrc::empty, "");
+
+static_assert(parseInt("21").map([](int x) { return x * 2; }).getValue() == 42, "");
+static_assert(parseInt("x").map([](int x) { return x * 2; }).getException().position == 0, "");
+static_assert(parseInt("x").or_else([](const ConfigError &) { return Result<int, ConfigError>::ok(7); }).getValue() == 7, "");
+static_assert(parseInt("x").mapError([](const ConfigError & e) { return e.code; }).getException() == ConfigErrc::bad_digit, "");
+static_assert(Result<int, ConfigError>::ok(1).and_then(checkPort).getValue() == 1, "");
+
+constexpr Result<long, ConfigErrc> widen(Result<int, ConfigErrc> r) {
+    return std::move(r).map([](int && x) { return static_cast<long>(x); });
+}
+
+static_assert(widen(Result<int, ConfigErrc>::ok(3)).getValue() == 3L, "");
+static_assert(widen(Result<int, ConfigErrc>::failed(ConfigErrc::empty)).getException() == ConfigErrc::empty, "");
+
+constexpr Result<void, ConfigErrc> validate(int x) {
+    return x > 0 ? Result<void, ConfigErrc>::ok() : Result<void, ConfigErrc>::failed(ConfigErrc::out_of_range);
+}
+
+static_assert(validate(1).isOK(), "");
+static_assert(validate(0).getException() == ConfigErrc::out_of_range, "");
+static_assert(validate(1).map([] { return 5; }).getValue() == 5, "");
+
+// A lookup table built and validated at compile time.
+struct PortTable {
+    int ports[3];
+};
+
+constexpr Result<PortTable, ConfigError> buildTable(const char * a, const char * b, const char * c) {
+    const char * inputs[3] = {a, b, c};
+    PortTable table{};
+    for(int i = 0; i < 3; ++i) {
+        Result<int, ConfigError> port = parsePort(inputs[i]);
+        if(!port.isOK())
+            return Result<PortTable, ConfigError>::translateError(port);
+        table.ports[i] = port.getValue();
+    }
+    return Result<PortTable, ConfigError>::ok(table);
+}
+
+constexpr PortTable table = buildTable("80", "443", "8080").getValue();
+static_assert(table.ports[2] == 8080, "");
+static_assert(!buildTable("80", "0", "8080").isOK(), "");
+
+constexpr optional<int> twice(optional<int> o) {
+    return o.hasValue() ? optional<int>(o.getValue() * 2) : optional<int>();
+}
+
+constexpr int takeFrom(optional<int> o) {
+    int v = o.takeValue();
+    return o.hasValue() ? -1 : v;
+}
+
+static_assert(twice(optional<int>(4)).getValue() == 8, "");
+static_assert(!twice(optional<int>()).hasValue(), "");
+static_assert(takeFrom(optional<int>(6)) == 6, "");
+
+constexpr int global = 3;
+static_assert(optional<const int&>(global).getValue() == 3, "");
+
+}
+
+TEST(ResultConstexpr, CheckedAtCompileTime) {
+    assertThat(table.ports[0], is(80));
+}
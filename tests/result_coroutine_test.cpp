@@ -0,0 +1,97 @@
+#include "cxxutils/result_coroutine.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+enum class ParseErrc { negative };
+
+Result<int, ParseErrc> parse(int x) {
+    if(x < 0)
+        return Result<int, ParseErrc>::failed(ParseErrc::negative);
+    return Result<int, ParseErrc>::ok(x);
+}
+
+Result<int, ParseErrc> sum(int a, int b) {
+    int x = co_await parse(a);
+    int y = co_await parse(b);
+    co_return x + y;
+}
+
+}
+
+template<>
+struct result_error_converter<ParseErrc, ResultException> {
+    static ResultException convert(ParseErrc) {
+        return ResultException("parse", "negative");
+    }
+};
+
+namespace {
+
+Result<std::string> describe(int a) {
+    int s = co_await sum(a, 1);
+    co_return std::to_string(s);
+}
+
+Result<void> check(int a) {
+    co_await sum(a, a);
+    co_return;
+}
+
+// Counts live copies, so a frame that is never destroyed shows up as a
+// parameter copy that is never destroyed.
+struct Counted {
+    static int live;
+    Counted() { ++live; }
+    Counted(const Counted &) { ++live; }
+    ~Counted() { --live; }
+};
+
+int Counted::live = 0;
+
+Result<int> throwing(Counted, int a) {
+    int x = co_await sum(a, 1);
+    if(x > 0)
+        throw std::runtime_error("thrown in the body");
+    co_return x;
+}
+
+}
+
+TEST(ResultCoroutine, UnwrapsValues) {
+    Result<int, ParseErrc> r = sum(1, 2);
+    assertThat(r.isOK(), is(true));
+    assertThat(r.getValue(), is(3));
+}
+
+TEST(ResultCoroutine, ShortCircuitsOnFailure) {
+    Result<int, ParseErrc> r = sum(1, -2);
+    assertThat(r.isOK(), is(false));
+}
+
+TEST(ResultCoroutine, ConvertsErrorTypes) {
+    assertThat(describe(3), isResultWhereValue(is(std::string("4"))));
+    Result<std::string> failed = describe(-3);
+    assertThat(failed, isFailedResult());
+    assertThat(std::string(failed.getException().mesg()), is(std::string("negative")));
+}
+
+TEST(ResultCoroutine, VoidResult) {
+    assertThat(check(1).isOK(), is(true));
+    assertThat(check(-1).isOK(), is(false));
+}
+
+TEST(ResultCoroutine, ExceptionFromTheBodyBecomesAFailure) {
+    {
+        Counted c;
+        Result<int> r = throwing(c, 1);
+        assertThat(r, isFailedResult());
+        assertThat(std::string(r.getException().component()), is(std::string("coroutine")));
+        assertThat(std::string(r.getException().mesg()), is(std::string("thrown in the body")));
+        assertThat(throwing(c, -1), isFailedResult());
+    }
+    assertThat(Counted::live, is(0));
+}
@@ -0,0 +1,179 @@
+#include "cxxutils/result_deadline.hpp"
+#include "cxxutils/thread_pool.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using cxxutils::CancellationSource;
+using cxxutils::CancellationToken;
+using cxxutils::StopReason;
+
+namespace {
+
+// Sleeps in small steps until token stops or duration has passed.
+bool sleep_unless_stopped(const CancellationToken & token, std::chrono::milliseconds duration) {
+    auto until = std::chrono::steady_clock::now() + duration;
+    while(std::chrono::steady_clock::now() < until) {
+        if(token.stopRequested())
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}
+
+TEST(CancellationToken, DefaultNeverStops) {
+    CancellationToken token;
+    assertThat(token.stopReason() == StopReason::none, is(true));
+}
+
+TEST(CancellationToken, LinkedSourcesFollowTheirParent) {
+    CancellationSource parent;
+    CancellationSource child(parent.token());
+    assertThat(child.token().stopRequested(), is(false));
+    parent.cancel();
+    assertThat(child.token().stopReason() == StopReason::cancelled, is(true));
+    assertThat(child.isCancelled(), is(false));
+}
+
+TEST(CancellationToken, DeadlineOnlyMovesEarlier) {
+    CancellationToken expired = CancellationToken::after(std::chrono::seconds(-1));
+    assertThat(expired.stopReason() == StopReason::deadline_exceeded, is(true));
+    assertThat(expired.withTimeout(std::chrono::hours(1)).stopRequested(), is(true));
+    CancellationSource child(expired);
+    assertThat(child.token().stopReason() == StopReason::deadline_exceeded, is(true));
+}
+
+TEST(ResultDeadline, FlatmapRunsStepsUntilStopped) {
+    CancellationSource source;
+    int calls = 0;
+    auto step = [&](int x) { ++calls; return Result<int>::ok(x + 1); };
+    auto cancelling = [&](int x) { source.cancel(); return Result<int>::ok(x * 10); };
+    Result<int> r = ResultUtils::flatmap(Result<int>::ok(1), source.token(), step, cancelling, step);
+    assertThat(r, isFailedResult());
+    assertThat(cxxutils::is_cancelled(r.getException()), is(true));
+    assertThat(calls, is(1));
+}
+
+TEST(ResultDeadline, FlatmapPassesFailuresOn) {
+    Result<std::string> r = ResultUtils::flatmap(make_result_failed<int>("c", "m"), CancellationToken(),
+                                                 [](int x) { return Result<std::string>::ok(std::to_string(x)); });
+    assertThat(r, isFailedResult());
+    assertThat(std::string(r.getException().mesg()), is(std::string("m")));
+}
+
+TEST(ResultDeadline, FlatmapSucceedsBeforeTheDeadline) {
+    Result<std::string> r = ResultUtils::flatmap(Result<int>::ok(20), CancellationToken::after(std::chrono::hours(1)),
+                                                 [](int x) { return Result<int>::ok(x + 1); },
+                                                 [](int x) { return Result<std::string>::ok(std::to_string(x)); });
+    assertThat(r, isResultWhereValue(is(std::string("21"))));
+}
+
+TEST(ResultDeadline, TraverseTimesOut) {
+    std::vector<int> input = {1, 2, 3};
+    Result<std::vector<int>> r = ResultUtils::traverse(input, CancellationToken::after(std::chrono::seconds(-1)),
+                                                       [](int x) { return Result<int>::ok(x); });
+    assertThat(r, isFailedResult());
+    assertThat(cxxutils::is_timeout(r.getException()), is(true));
+}
+
+TEST(ResultDeadline, TraverseStopsBetweenElements) {
+    std::vector<int> input = {1, 2, 3, 4};
+    CancellationSource source;
+    int calls = 0;
+    Result<std::vector<int>> r = ResultUtils::traverse(input, source.token(), [&](int x) {
+        ++calls;
+        if(x == 2)
+            source.cancel();
+        return Result<int>::ok(x);
+    });
+    assertThat(r, isFailedResult());
+    assertThat(calls, is(2));
+}
+
+TEST(LatencyTracker, PercentilesAreBucketUpperBounds) {
+    cxxutils::LatencyTracker latency;
+    assertThat(latency.percentile(0.5).count(), is(0));
+    for(int i = 0; i < 90; ++i)
+        latency.record(std::chrono::microseconds(100));
+    for(int i = 0; i < 10; ++i)
+        latency.record(std::chrono::milliseconds(10));
+    assertThat(static_cast<int>(latency.count()), is(100));
+    auto p50 = latency.percentile(0.5);
+    auto p99 = latency.percentile(0.99);
+    EXPECT_GE(p50, std::chrono::microseconds(100));
+    EXPECT_LE(p50, std::chrono::microseconds(125));
+    EXPECT_GE(p99, std::chrono::milliseconds(10));
+    EXPECT_LE(p99, std::chrono::microseconds(12500));
+}
+
+TEST(LatencyTracker, LongestLatencyDoesNotOverflow) {
+    cxxutils::LatencyTracker latency;
+    latency.record(std::chrono::nanoseconds::max());
+    assertThat(latency.percentile(1.0) == std::chrono::nanoseconds::max(), is(true));
+}
+
+TEST(Hedged, BackupWinsWhenThePrimaryIsSlow) {
+    cxxutils::LatencyTracker latency;
+    cxxutils::HedgeOptions options;
+    options.initialDelay = std::chrono::milliseconds(5);
+    std::atomic<int> attempts{0};
+    std::atomic<bool> primaryStopped{false};
+    {
+        cxxutils::WorkStealingPool pool(2);
+        auto start = std::chrono::steady_clock::now();
+        Result<int> r = ResultUtils::hedged([&](const CancellationToken & token) {
+            if(attempts.fetch_add(1) == 0) {
+                if(!sleep_unless_stopped(token, std::chrono::seconds(5)))
+                    primaryStopped = true;
+                return Result<int>::ok(1);
+            }
+            return Result<int>::ok(2);
+        }, latency, pool, CancellationToken(), options);
+        assertThat(r, isResultWhereValue(is(2)));
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    }
+    // The winner and the primary it beat, at the time it had run so far.
+    assertThat(static_cast<int>(latency.count()), is(2));
+    EXPECT_GE(latency.percentile(1.0), options.initialDelay);
+    assertThat(primaryStopped.load(), is(true));
+}
+
+TEST(Hedged, FastPrimaryDoesNotHedge) {
+    cxxutils::LatencyTracker latency;
+    int attempts = 0;
+    Result<int> r = ResultUtils::hedged([&](const CancellationToken &) { ++attempts; return Result<int>::ok(7); },
+                                        latency, cxxutils::InlineExecutor::instance());
+    assertThat(r, isResultWhereValue(is(7)));
+    assertThat(attempts, is(1));
+}
+
+TEST(Hedged, FailureStartsTheBackupAndFailuresAreCombined) {
+    cxxutils::LatencyTracker latency;
+    int attempts = 0;
+    Result<int> r = ResultUtils::hedged([&](const CancellationToken &) {
+        ++attempts;
+        return make_result_failed<int>("c", "e" + std::to_string(attempts));
+    }, latency, cxxutils::InlineExecutor::instance());
+    assertThat(r, isFailedResult());
+    assertThat(attempts, is(2));
+    assertThat(std::string(r.getException().mesg()), is(std::string("2 failures; c: e1; c: e2")));
+    assertThat(static_cast<int>(latency.count()), is(2));
+}
+
+TEST(Hedged, CallerDeadlineStopsTheWait) {
+    cxxutils::WorkStealingPool pool(2);
+    cxxutils::LatencyTracker latency;
+    Result<int> r = ResultUtils::hedged([](const CancellationToken & token) {
+        if(!sleep_unless_stopped(token, std::chrono::seconds(5)))
+            return make_result_failed<int>("c", "gave up");
+        return Result<int>::ok(1);
+    }, latency, pool, CancellationToken::after(std::chrono::milliseconds(20)));
+    assertThat(r, isFailedResult());
+    assertThat(cxxutils::is_timeout(r.getException()), is(true));
+}
@@ -0,0 +1,53 @@
+#include "cxxutils/result_lazy.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <vector>
+
+using namespace ResultUtils;
+
+namespace {
+
+struct CountingBuffer {
+    static int copies;
+    std::vector<char> data;
+
+    explicit CountingBuffer(std::size_t n) : data(n) {}
+    CountingBuffer(const CountingBuffer & o) : data(o.data) { ++copies; }
+    CountingBuffer(CountingBuffer &&) = default;
+    CountingBuffer& operator=(const CountingBuffer & o) { data = o.data; ++copies; return *this; }
+    CountingBuffer& operator=(CountingBuffer &&) = default;
+};
+
+int CountingBuffer::copies = 0;
+
+}
+
+TEST(ResultLazy, FusedChainMovesWithoutCopies) {
+    CountingBuffer::copies = 0;
+    Result<std::size_t> r = lazy(Result<CountingBuffer>::ok(CountingBuffer(10)))
+        .map([](CountingBuffer && b) { b.data.push_back(1); return std::move(b); })
+        .map([](CountingBuffer && b) { return std::move(b); })
+        .flatmap([](CountingBuffer && b) { return Result<CountingBuffer>::ok(std::move(b)); })
+        .map([](CountingBuffer && b) { return b.data.size(); });
+    assertThat(r, isResultWhereValue(is(11u)));
+    assertThat(CountingBuffer::copies, is(0));
+}
+
+TEST(ResultLazy, EagerRvalueChainMovesWithoutCopies) {
+    CountingBuffer::copies = 0;
+    Result<std::size_t> r = Result<CountingBuffer>::ok(CountingBuffer(10))
+        .map([](CountingBuffer && b) { return std::move(b); })
+        .and_then([](CountingBuffer && b) { return Result<CountingBuffer>::ok(std::move(b)); })
+        .map([](CountingBuffer && b) { return b.data.size(); });
+    assertThat(r, isResultWhereValue(is(10u)));
+    assertThat(CountingBuffer::copies, is(0));
+}
+
+TEST(ResultLazy, FailurePassesThrough) {
+    int calls = 0;
+    Result<int> r = lazy(make_result_failed<int>("c", "m"))
+        .map([&](int x) { ++calls; return x; })
+        .run();
+    assertThat(r, isFailedResult());
+    assertThat(calls, is(0));
+}
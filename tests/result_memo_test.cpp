@@ -0,0 +1,201 @@
+#include "cxxutils/result_memo.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using cxxutils::MemoCache;
+using cxxutils::MemoOptions;
+
+namespace {
+
+struct Counted {
+    static std::atomic<int> live;
+    int value;
+    explicit Counted(int v) : value(v) { ++live; }
+    Counted(const Counted & o) : value(o.value) { ++live; }
+    Counted& operator=(const Counted &) = default;
+    ~Counted() { --live; }
+};
+
+std::atomic<int> Counted::live{0};
+
+}
+
+static_assert(!std::is_move_constructible<MemoCache<int, int>>::value, "a moved-from cache would be unusable");
+
+TEST(ResultMemo, CachesValues) {
+    int calls = 0;
+    auto square = cxxutils::memoize<int>([&](int x) { ++calls; return Result<int>::ok(x * x); });
+    assertThat(square(3), isResultWhereValue(is(9)));
+    assertThat(square(3), isResultWhereValue(is(9)));
+    assertThat(square(4), isResultWhereValue(is(16)));
+    assertThat(calls, is(2));
+    cxxutils::MemoStats stats = square.stats();
+    assertThat(static_cast<int>(stats.hits), is(1));
+    assertThat(static_cast<int>(stats.misses), is(2));
+}
+
+TEST(ResultMemo, FailuresExpireAfterTheirTtl) {
+    MemoOptions options;
+    options.failureTtl = std::chrono::milliseconds(20);
+    MemoCache<std::string, int> cache(options);
+    int calls = 0;
+    auto fail = [&](const std::string &) { ++calls; return make_result_failed<int>("lookup", "not found"); };
+    assertThat(cache.get("a", fail), isFailedResult());
+    Result<int> cached = cache.get("a", fail);
+    assertThat(cached, isFailedResult());
+    assertThat(std::string(cached.getException().mesg()), is(std::string("not found")));
+    assertThat(calls, is(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    assertThat(cache.get("a", fail), isFailedResult());
+    assertThat(calls, is(2));
+    assertThat(static_cast<int>(cache.stats().expirations), is(1));
+}
+
+TEST(ResultMemo, ZeroTtlDisablesNegativeCaching) {
+    MemoOptions options;
+    options.failureTtl = std::chrono::nanoseconds::zero();
+    MemoCache<int, int> cache(options);
+    int calls = 0;
+    auto fail = [&](int) { ++calls; return make_result_failed<int>("c", "m"); };
+    assertThat(cache.get(1, fail), isFailedResult());
+    assertThat(cache.get(1, fail), isFailedResult());
+    assertThat(calls, is(2));
+    assertThat(static_cast<int>(cache.size()), is(0));
+}
+
+TEST(ResultMemo, EvictionIsBounded) {
+    MemoOptions options;
+    options.capacity = 8;
+    options.shards = 1;
+    MemoCache<int, int> cache(options);
+    assertThat(static_cast<int>(cache.capacity()), is(8));
+    for(int i = 0; i < 20; ++i)
+        assertThat(cache.get(i, [](int x) { return Result<int>::ok(x); }), isResultWhereValue(is(i)));
+    assertThat(static_cast<int>(cache.size()), is(8));
+    assertThat(static_cast<int>(cache.stats().evictions), is(12));
+}
+
+TEST(ResultMemo, ClockKeepsRecentlyUsedEntries) {
+    MemoOptions options;
+    options.capacity = 8;
+    options.shards = 1;
+    MemoCache<int, int> cache(options);
+    int calls = 0;
+    auto identity = [&](int x) { ++calls; return Result<int>::ok(x); };
+    for(int i = 0; i < 8; ++i)
+        assertThat(cache.get(i, identity), isValidResult());
+    for(int i = 0; i < 8; i += 2)
+        assertThat(cache.get(i, identity), isValidResult());
+    for(int i = 8; i < 12; ++i)
+        assertThat(cache.get(i, identity), isValidResult());
+    calls = 0;
+    for(int i = 0; i < 8; i += 2)
+        assertThat(cache.get(i, identity), isValidResult());
+    assertThat(calls, is(0));
+}
+
+TEST(ResultMemo, InvalidateAndClear) {
+    MemoCache<int, int> cache;
+    int calls = 0;
+    auto identity = [&](int x) { ++calls; return Result<int>::ok(x); };
+    assertThat(cache.get(1, identity), isValidResult());
+    assertThat(cache.get(2, identity), isValidResult());
+    cache.invalidate(1);
+    assertThat(cache.get(1, identity), isValidResult());
+    assertThat(cache.get(2, identity), isValidResult());
+    assertThat(calls, is(3));
+    cache.clear();
+    assertThat(static_cast<int>(cache.size()), is(0));
+}
+
+TEST(ResultMemo, ConcurrentMissesComputeOnce) {
+    MemoCache<int, std::string> cache;
+    std::atomic<int> calls{0};
+    std::vector<std::thread> threads;
+    std::vector<std::string> seen(8);
+    for(int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            Result<std::string> r = cache.get(42, [&](int x) {
+                ++calls;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return Result<std::string>::ok(std::to_string(x));
+            });
+            if(r.isOK())
+                seen[t] = r.getValue();
+        });
+    }
+    for(std::thread & t : threads)
+        t.join();
+    assertThat(calls.load(), is(1));
+    for(const std::string & s : seen)
+        assertThat(s, is(std::string("42")));
+    cxxutils::MemoStats stats = cache.stats();
+    assertThat(static_cast<int>(stats.misses), is(1));
+    assertThat(static_cast<int>(stats.hits + stats.coalesced), is(7));
+}
+
+TEST(ResultMemo, ConcurrentHitsAndEvictions) {
+    MemoOptions options;
+    options.capacity = 64;
+    options.shards = 4;
+    MemoCache<int, int> cache(options);
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for(int i = 0; i < 20000; ++i) {
+                int key = (i * 7 + t) % 200;
+                Result<int> r = cache.get(key, [](int x) { return Result<int>::ok(x * 3); });
+                if(!r.isOK() || r.getValue() != key * 3)
+                    ++wrong;
+            }
+        });
+    }
+    for(std::thread & t : threads)
+        t.join();
+    assertThat(wrong.load(), is(0));
+    EXPECT_LE(cache.size(), cache.capacity());
+}
+
+TEST(ResultMemo, EvictedEntriesAreFreedInBatches) {
+    {
+        MemoOptions options;
+        options.capacity = 8;
+        options.shards = 1;
+        MemoCache<int, Counted> cache(options);
+        for(int i = 0; i < 200; ++i)
+            assertThat(cache.get(i, [](int x) { return Result<Counted>::ok(Counted(x)); }), isValidResult());
+        EXPECT_LE(Counted::live.load(), static_cast<int>(cache.capacity() + cxxutils::memo_detail::retire_batch));
+        cache.clear();
+        assertThat(Counted::live.load(), is(0));
+        assertThat(cache.get(1, [](int x) { return Result<Counted>::ok(Counted(x)); }), isValidResult());
+    }
+    assertThat(Counted::live.load(), is(0));
+}
+
+TEST(ResultMemo, ThrowingComputeReleasesWaiters) {
+    MemoCache<int, int> cache;
+    std::thread thrower([&] {
+        try {
+            cache.get(7, [&](int) -> Result<int> {
+                while(cache.stats().coalesced == 0)
+                    std::this_thread::yield();
+                throw std::runtime_error("lookup failed");
+            });
+        } catch(const std::runtime_error &) {
+        }
+    });
+    while(cache.stats().misses == 0)
+        std::this_thread::yield();
+    Result<int> r = cache.get(7, [](int x) { return Result<int>::ok(x * 2); });
+    thrower.join();
+    assertThat(r, isResultWhereValue(is(14)));
+    assertThat(cache.get(7, [](int) { return Result<int>::ok(0); }), isResultWhereValue(is(14)));
+}
@@ -0,0 +1,80 @@
+#define CXXUTILS_RESULT_METRICS
+#include "cxxutils/result.hpp"
+#include "cxxutils/result_batch.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// This file is built as its own executable: the metrics macro must be
+// defined consistently for every translation unit that includes result.hpp.
+
+namespace {
+
+const cxxutils::ComponentFailureStats* find(const cxxutils::ResultMetricsSnapshot & s, const std::string & component) {
+    for(const cxxutils::ComponentFailureStats & c : s.components) {
+        if(c.component == component)
+            return &c;
+    }
+    return nullptr;
+}
+
+Result<int> failing(const ResultComponent & component) {
+    return make_result_failed<int>(component, "failed");
+}
+
+void create(const ResultComponent & component) {
+    ResultException(component, "failed");
+}
+
+}
+
+TEST(ResultMetrics, CountsCreationAndPropagationPerComponent) {
+    ResultComponent storage("metrics.storage");
+    ResultComponent network("metrics.network");
+    Result<int> a = failing(storage);
+    Result<int> b = failing(storage);
+    Result<int> c = failing(network);
+    Result<std::string> mapped = a.map([](int x) { return std::to_string(x); });
+    Result<int> chained = std::move(b).flatmap([](int x) { return Result<int>::ok(x); });
+    assertThat(c, isFailedResult());
+    assertThat(mapped, isFailedResult());
+    assertThat(chained, isFailedResult());
+
+    cxxutils::ResultMetricsSnapshot s = cxxutils::ResultMetrics::snapshot();
+    assertThat(find(s, "metrics.storage")->created, is(2u));
+    assertThat(find(s, "metrics.storage")->propagated, is(2u));
+    assertThat(find(s, "metrics.network")->created, is(1u));
+    assertThat(find(s, "metrics.network")->propagated, is(0u));
+}
+
+TEST(ResultMetrics, CountsFromExitedThreads) {
+    ResultComponent component("metrics.threads");
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for(int i = 0; i < 1000; ++i)
+                create(component);
+        });
+    }
+    for(std::thread & t : threads)
+        t.join();
+    assertThat(find(cxxutils::ResultMetrics::snapshot(), "metrics.threads")->created, is(4000u));
+}
+
+TEST(ResultMetrics, RatesAndExport) {
+    ResultComponent component("metrics.export");
+    create(component);
+    cxxutils::ResultMetricsSnapshot first = cxxutils::ResultMetrics::snapshot();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for(int i = 0; i < 10; ++i)
+        create(component);
+    cxxutils::ResultMetricsSnapshot second = cxxutils::ResultMetrics::snapshot(first);
+    assertThat(find(second, "metrics.export")->createdRate > 0, is(true));
+
+    std::ostringstream out;
+    cxxutils::ResultMetrics::writePrometheus(out, second);
+    assertThat(out.str().find("cxxutils_result_failures_created_total{component=\"metrics.export\"} 11\n") != std::string::npos, is(true));
+}
@@ -0,0 +1,107 @@
+#include "cxxutils/result_parallel.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace ResultUtils;
+
+TEST(ResultParallel, ValuesComeBackInOrder) {
+    cxxutils::WorkStealingPool pool(4);
+    std::vector<int> in(10000);
+    std::iota(in.begin(), in.end(), 0);
+    Result<std::vector<long>> r = parallel_traverse(in, [](int x) { return Result<long>::ok(x * 2L); }, pool);
+    assertThat(r, isValidResult());
+    for(std::size_t i = 0; i < in.size(); ++i)
+        ASSERT_EQ(r.getValue()[i], 2L * i);
+}
+
+TEST(ResultParallel, ReportsLowestIndexFailure) {
+    cxxutils::WorkStealingPool pool(4);
+    std::vector<int> in(10000);
+    std::iota(in.begin(), in.end(), 0);
+    for(int rep = 0; rep < 20; ++rep) {
+        Result<std::vector<int>> r = parallel_traverse(in, [](int x) {
+            if(x % 997 == 996)
+                return make_result_failed<int>("check", std::to_string(x));
+            return Result<int>::ok(x);
+        }, pool);
+        ASSERT_FALSE(r.isOK());
+        ASSERT_EQ(std::string(r.getException().mesg()), "996");
+    }
+}
+
+TEST(ResultParallel, FailedInputPropagates) {
+    Result<std::vector<int>> in = make_result_failed<std::vector<int>>("c", "m");
+    assertThat(parallel_traverse(in, [](int x) { return Result<int>::ok(x); }), isFailedResult());
+}
+
+TEST(ResultParallel, ParallelMap) {
+    std::vector<int> in{1, 2, 3};
+    assertThat(parallel_map(in, [](int x) { return x + 1; }), isResultWhereValue(is(std::vector<int>{2, 3, 4})));
+    assertThat(parallel_map(std::vector<int>(), [](int x) { return x; }), isValidResult());
+}
+
+TEST(ResultParallel, ExceptionIsRethrownAfterEveryChunkFinishes) {
+    cxxutils::WorkStealingPool pool(4);
+    std::vector<int> in(10000);
+    std::iota(in.begin(), in.end(), 0);
+    for(int rep = 0; rep < 20; ++rep) {
+        std::atomic<int> running{0};
+        try {
+            parallel_traverse(in, [&](int x) {
+                running.fetch_add(1);
+                if(x == 500)
+                    throw std::runtime_error("boom");
+                if(x == 3000) {
+                    running.fetch_sub(1);
+                    return make_result_failed<int>("check", "later");
+                }
+                running.fetch_sub(1);
+                return Result<int>::ok(x);
+            }, pool);
+            FAIL() << "expected an exception";
+        } catch(const std::runtime_error & e) {
+            ASSERT_EQ(std::string(e.what()), "boom");
+        }
+        // Only the throwing call never finished; no other call is still
+        // running against the range.
+        ASSERT_EQ(running.load(), 1);
+    }
+}
+
+TEST(ResultParallel, LowerFailureWinsOverALaterException) {
+    cxxutils::WorkStealingPool pool(4);
+    std::vector<int> in(1000);
+    std::iota(in.begin(), in.end(), 0);
+    Result<std::vector<int>> r = parallel_traverse(in, [](int x) {
+        if(x == 900)
+            throw std::runtime_error("late");
+        if(x == 10)
+            return make_result_failed<int>("check", "early");
+        return Result<int>::ok(x);
+    }, pool);
+    ASSERT_FALSE(r.isOK());
+    ASSERT_EQ(std::string(r.getException().mesg()), "early");
+}
+
+TEST(WorkStealingPool, ThrowingTaskDoesNotStopTheWorker) {
+    cxxutils::WorkStealingPool pool(1);
+    pool.submit([] { throw std::runtime_error("dropped"); });
+    std::mutex m;
+    std::condition_variable cv;
+    bool ran = false;
+    pool.submit([&] {
+        std::lock_guard<std::mutex> lock(m);
+        ran = true;
+        cv.notify_all();
+    });
+    std::unique_lock<std::mutex> lock(m);
+    ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(10), [&] { return ran; }));
+}
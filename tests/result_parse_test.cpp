@@ -0,0 +1,132 @@
+#include "cxxutils/result_parse.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using cxxutils::FieldSplitter;
+using cxxutils::LineScanner;
+using cxxutils::ParseErrc;
+using cxxutils::ParseError;
+using cxxutils::parse_number;
+
+static_assert(std::is_trivially_copyable<Result<std::string_view, ParseError>>::value, "");
+
+namespace {
+
+std::vector<std::string> lines(std::string_view text) {
+    std::vector<std::string> out;
+    LineScanner scanner(text);
+    for(optional<std::string_view> line = scanner.next(); line.hasValue(); line = scanner.next())
+        out.emplace_back(line.getValue());
+    return out;
+}
+
+template<typename T>
+T valueOf(const Result<T, ParseError> & r) {
+    EXPECT_TRUE(r.isOK());
+    return r.getValue();
+}
+
+std::vector<std::string> fields(std::string_view text, char delimiter) {
+    std::vector<std::string> out;
+    FieldSplitter splitter(text, delimiter);
+    while(!splitter.atEnd()) {
+        Result<std::string_view, ParseError> field = splitter.next();
+        EXPECT_TRUE(field.isOK());
+        out.emplace_back(field.getValue());
+    }
+    return out;
+}
+
+}
+
+TEST(ResultParse, ParsesWholeNumbers) {
+    assertThat(valueOf(parse_number<int>("-42")), is(-42));
+    assertThat(valueOf(parse_number<unsigned long long>("18446744073709551615")), is(18446744073709551615ull));
+    assertThat(valueOf(parse_number<double>("2.5e3")), is(2500.0));
+}
+
+TEST(ResultParse, NumberFailuresCarryTheirOffset) {
+    Result<int, ParseError> trailing = parse_number<int>("12x4", 100);
+    ASSERT_FALSE(trailing.isOK());
+    assertThat(trailing.getException().code == ParseErrc::trailing_characters, is(true));
+    assertThat(trailing.getException().offset, is(102u));
+
+    Result<int, ParseError> invalid = parse_number<int>(" 1", 7);
+    ASSERT_FALSE(invalid.isOK());
+    assertThat(invalid.getException().code == ParseErrc::invalid_number, is(true));
+    assertThat(invalid.getException().offset, is(7u));
+
+    Result<signed char, ParseError> range = parse_number<signed char>("300");
+    ASSERT_FALSE(range.isOK());
+    assertThat(range.getException().code == ParseErrc::out_of_range, is(true));
+
+    Result<double, ParseError> empty = parse_number<double>("");
+    ASSERT_FALSE(empty.isOK());
+    assertThat(empty.getException().code == ParseErrc::empty_field, is(true));
+}
+
+TEST(ResultParse, LinesHandleCrLfAndAMissingFinalNewline) {
+    assertThat(lines("a\r\nbb\n\nccc"), is(std::vector<std::string>{"a", "bb", "", "ccc"}));
+    assertThat(lines("x\n"), is(std::vector<std::string>{"x"}));
+    assertThat(lines(""), is(std::vector<std::string>{}));
+}
+
+TEST(ResultParse, LongLinesAreFoundAcrossBlocks) {
+    std::string text(100, 'a');
+    text += '\n';
+    text += std::string(37, 'b');
+    assertThat(lines(text), is(std::vector<std::string>{std::string(100, 'a'), std::string(37, 'b')}));
+}
+
+TEST(ResultParse, FieldsKeepEmptyOnes) {
+    assertThat(fields("a,,b,", ','), is(std::vector<std::string>{"a", "", "b", ""}));
+    assertThat(fields("", ','), is(std::vector<std::string>{""}));
+    assertThat(fields("one field that is longer than sixteen bytes", '\t'),
+               is(std::vector<std::string>{"one field that is longer than sixteen bytes"}));
+}
+
+TEST(ResultParse, FieldsAreViewsIntoTheInput) {
+    std::string text = "alpha,beta";
+    FieldSplitter splitter(text, ',');
+    Result<std::string_view, ParseError> first = splitter.next();
+    ASSERT_TRUE(first.isOK());
+    assertThat(first.getValue().data() == text.data(), is(true));
+}
+
+TEST(ResultParse, TypedFieldsReportInputOffsets) {
+    std::string_view text = "1,2\n3,x4\n";
+    LineScanner scanner(text);
+    scanner.next();
+    optional<std::string_view> line = scanner.next();
+    assertThat(line.hasValue(), is(true));
+    assertThat(scanner.offset(), is(4u));
+    FieldSplitter splitter(line.getValue(), ',', scanner.offset());
+    assertThat(valueOf(splitter.nextAs<int>()), is(3));
+    Result<int, ParseError> bad = splitter.nextAs<int>();
+    ASSERT_FALSE(bad.isOK());
+    assertThat(bad.getException().offset, is(6u));
+    Result<int, ParseError> missing = splitter.nextAs<int>();
+    ASSERT_FALSE(missing.isOK());
+    assertThat(missing.getException().code == ParseErrc::missing_field, is(true));
+}
+
+TEST(ResultParse, ExpectEndRejectsExtraFields) {
+    FieldSplitter splitter("1,2", ',');
+    assertThat(valueOf(splitter.nextAs<int>()), is(1));
+    Result<void, ParseError> extra = splitter.expectEnd();
+    ASSERT_FALSE(extra.isOK());
+    assertThat(extra.getException().offset, is(2u));
+    assertThat(valueOf(splitter.nextAs<int>()), is(2));
+    EXPECT_TRUE(splitter.expectEnd().isOK());
+}
+
+TEST(ResultParse, ConvertsToResultException) {
+    Result<int, ParseError> bad = parse_number<int>("abc", 12);
+    Result<int> converted = Result<int>::translateError(bad);
+    ASSERT_FALSE(converted.isOK());
+    assertThat(converted.getException().component(), is(std::string("parse")));
+    assertThat(std::string(converted.getException().mesg()), is(std::string("invalid number at offset 12")));
+}
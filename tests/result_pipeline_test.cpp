@@ -0,0 +1,167 @@
+#include "cxxutils/result_pipeline.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace ResultUtils;
+
+namespace {
+
+enum class Odd { odd };
+
+}
+
+template<>
+struct result_error_converter<Odd, ResultException> {
+    static ResultException convert(Odd) {
+        return ResultException("evens", "odd input");
+    }
+};
+
+namespace {
+
+Result<int> parse(const std::string & s) {
+    if(s.empty() || s[0] == 'x')
+        return make_result_failed<int>("parse", "not a number: " + s);
+    return Result<int>::ok(std::stoi(s));
+}
+
+Result<int, Odd> evens(int x) {
+    if(x % 2 != 0)
+        return Result<int, Odd>::failed(Odd::odd);
+    return Result<int, Odd>::ok(x);
+}
+
+std::vector<std::string> makeInput(std::size_t n) {
+    std::vector<std::string> in;
+    for(std::size_t i = 0; i < n; ++i)
+        in.push_back(i % 10 == 7 ? "x" : std::to_string(i));
+    return in;
+}
+
+// Copying the record numbered `poisoned` throws, as reading a bad input
+// might.
+struct Fragile {
+    static int poisoned;
+    int n;
+
+    explicit Fragile(int n_in) : n(n_in) {}
+    Fragile(const Fragile & o) : n(o.n) {
+        if(n == poisoned)
+            throw std::runtime_error("bad record");
+    }
+    Fragile(Fragile &&) = default;
+};
+
+int Fragile::poisoned = -1;
+
+PipelineOptions options(bool concurrent, std::size_t batchSize) {
+    PipelineOptions o;
+    o.concurrent = concurrent;
+    o.batchSize = batchSize;
+    o.queueCapacity = 2;
+    return o;
+}
+
+void checkRun(bool concurrent) {
+    auto pipeline = Pipeline<std::string>(options(concurrent, 16))
+        .then("parse", parse)
+        .then("evens", evens)
+        .then("describe", [](int x) { return Result<std::string>::ok("#" + std::to_string(x)); });
+    std::vector<std::string> out;
+    PipelineRun run = pipeline.run(makeInput(1000), [&](std::string && s) { out.push_back(std::move(s)); });
+
+    // Records 7, 17, ... fail to parse; every other odd record fails in evens.
+    assertThat(run.recordsIn, is(1000u));
+    assertThat(run.delivered, is(500u));
+    assertThat(out.size(), is(500u));
+    assertThat(out.front(), is(std::string("#0")));
+    assertThat(out.back(), is(std::string("#998")));
+    assertThat(run.failures.size(), is(500u));
+    assertThat(run.failures[0].record, is(1u));
+    assertThat(run.failures[0].stage, is(1u));
+    assertThat(run.failures[0].error.component(), is(std::string("evens")));
+    assertThat(run.failures[3].record, is(7u));
+    assertThat(run.failures[3].stage, is(0u));
+    assertThat(std::string(run.failures[3].error.mesg()), is(std::string("not a number: x")));
+
+    std::vector<StageStats> stats = pipeline.stats();
+    assertThat(stats.size(), is(3u));
+    assertThat(stats[0].name, is(std::string("parse")));
+    assertThat(stats[0].recordsIn, is(std::uint64_t(1000)));
+    assertThat(stats[0].failures, is(std::uint64_t(100)));
+    assertThat(stats[1].recordsIn, is(std::uint64_t(900)));
+    assertThat(stats[1].recordsOut, is(std::uint64_t(500)));
+    assertThat(stats[2].recordsOut, is(std::uint64_t(500)));
+    assertThat(stats[0].batches >= 63u, is(true));
+}
+
+}
+
+TEST(ResultPipeline, SequentialRunKeepsOrderAndReportsFailures) {
+    checkRun(false);
+}
+
+TEST(ResultPipeline, ConcurrentRunKeepsOrderAndReportsFailures) {
+    checkRun(true);
+}
+
+TEST(ResultPipeline, StagesReceiveMoveOnlyRecords) {
+    auto pipeline = Pipeline<int>(options(true, 4))
+        .then("box", [](int x) { return Result<std::unique_ptr<int>>::ok(std::unique_ptr<int>(new int(x))); })
+        .then("unbox", [](std::unique_ptr<int> && p) { return Result<int>::ok(*p * 2); });
+    int total = 0;
+    std::vector<int> in{1, 2, 3, 4, 5, 6, 7, 8, 9};
+    PipelineRun run = pipeline.run(in, [&](int x) { total += x; });
+    assertThat(run.delivered, is(9u));
+    assertThat(total, is(90));
+}
+
+TEST(ResultPipeline, EmptyInputStillCompletes) {
+    auto pipeline = Pipeline<std::string>(options(true, 8)).then("parse", parse);
+    PipelineRun run = pipeline.run(std::vector<std::string>(), [](int) {});
+    assertThat(run.recordsIn, is(0u));
+    assertThat(run.delivered, is(0u));
+}
+
+TEST(ResultPipeline, FailureHandlerReceivesFailuresAsTheyHappen) {
+    std::mutex mutex;
+    std::vector<std::size_t> records;
+    auto pipeline = Pipeline<std::string>(options(true, 8))
+        .then("parse", parse)
+        .onFailure([&](const PipelineFailure & f) {
+            std::lock_guard<std::mutex> lock(mutex);
+            records.push_back(f.record);
+        });
+    PipelineRun run = pipeline.run(makeInput(30), [](int) {});
+    assertThat(run.failures.empty(), is(true));
+    assertThat(records, is(std::vector<std::size_t>{7, 17, 27}));
+}
+
+TEST(ResultPipeline, StatsAccumulateAcrossRuns) {
+    auto pipeline = Pipeline<std::string>(options(false, 100)).then("parse", parse);
+    pipeline.run(makeInput(10), [](int) {});
+    pipeline.run(makeInput(10), [](int) {});
+    std::vector<StageStats> stats = pipeline.stats();
+    assertThat(stats[0].recordsIn, is(std::uint64_t(20)));
+    assertThat(stats[0].batches, is(std::uint64_t(2)));
+    assertThat(stats[0].throughput() > 0, is(true));
+}
+
+TEST(ResultPipeline, ThrowingInputStillJoinsTheStages) {
+    auto pipeline = Pipeline<Fragile>(options(true, 4))
+        .then("unwrap", [](Fragile && f) { return Result<int>::ok(f.n); });
+    std::vector<Fragile> in;
+    for(int i = 0; i < 20; ++i)
+        in.emplace_back(i);
+    std::atomic<int> delivered{0};
+    Fragile::poisoned = 10;
+    EXPECT_THROW(pipeline.run(in, [&](int) { ++delivered; }), std::runtime_error);
+    Fragile::poisoned = -1;
+    assertThat(delivered.load(), is(8));
+}
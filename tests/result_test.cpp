@@ -0,0 +1,281 @@
+#include "cxxutils/result.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class ParseErrc { empty, bad_digit };
+
+}
+
+template<>
+struct result_error_converter<ParseErrc, ResultException> {
+    static ResultException convert(ParseErrc e) {
+        return ResultException("parse", e == ParseErrc::empty ? "empty" : "bad digit");
+    }
+};
+
+static_assert(std::is_trivially_copyable<Result<int, ParseErrc>>::value, "");
+static_assert(sizeof(Result<int, ParseErrc>) == 8, "register sized");
+static_assert(sizeof(ResultException) == sizeof(void*), "errors are a single pointer");
+
+TEST(Result, OkAndFailed) {
+    assertThat(Result<int>::ok(3), isResultWhereValue(is(3)));
+    assertThat(make_result_failed<int>("component", "message"), isFailedResult());
+}
+
+TEST(Result, ExceptionAccessors) {
+    Result<int> r = make_result_failed<int>("component", "message");
+    assertThat(r, isFailedResult());
+    assertThat(r.getException().component(), is(std::string("component")));
+    assertThat(std::string(r.getException().mesg()), is(std::string("message")));
+    EXPECT_THROW(r.getValueOrThrow(), ResultException);
+}
+
+TEST(Result, CopiesShareThePayload) {
+    Result<int> r = make_result_failed<int>("component", "message");
+    Result<double> t = Result<double>::translateError(r);
+    assertThat(t, isFailedResult());
+    assertThat(t.getException().mesg(), is(r.getException().mesg()));
+}
+
+TEST(Result, MovedFromFailureStaysUsable) {
+    ResultException original("component", "message");
+    ResultException moved(std::move(original));
+    ResultException copy(original);
+    assertThat(copy.component(), is(std::string("unknown component")));
+    assertThat(std::string(original.mesg()), is(std::string("Unknown exception")));
+    assertThat(moved.component(), is(std::string("component")));
+    original.addContext("outer", "while testing");
+    assertThat(original.context().size(), is(std::size_t(1)));
+    assertThat(std::string(original.mesg()), is(std::string("Unknown exception")));
+    assertThat(ResultException().describe(), is(std::string("unknown component: Unknown exception")));
+
+    Result<int> r = make_result_failed<int>("component", "message");
+    assertThat(r, isFailedResult());
+    ResultException taken = r.takeException();
+    Result<int> again = Result<int>::translateError(r);
+    assertThat(again, isFailedResult());
+    assertThat(again.getException().component(), is(std::string("unknown component")));
+    assertThat(taken.component(), is(std::string("component")));
+}
+
+TEST(Result, ComponentsInternedOnEveryThreadMatch) {
+    ResultComponent expected("interned on many threads");
+    std::vector<std::thread> threads;
+    std::vector<int> matches(4, 0);
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for(int i = 0; i < 100; ++i) {
+                ResultException e("interned on many threads", "m");
+                matches[t] += e.componentHandle() == expected;
+            }
+        });
+    }
+    for(std::thread & t : threads)
+        t.join();
+    for(int m : matches)
+        assertThat(m, is(100));
+}
+
+namespace {
+
+// Copying throws while throwOnCopy is set; live counts every instance.
+struct FragileCopy {
+    static int live;
+    static bool throwOnCopy;
+
+    FragileCopy() { ++live; }
+    FragileCopy(const FragileCopy &) {
+        if(throwOnCopy)
+            throw std::runtime_error("copy");
+        ++live;
+    }
+    FragileCopy& operator=(const FragileCopy &) = default;
+    ~FragileCopy() { --live; }
+};
+
+int FragileCopy::live = 0;
+bool FragileCopy::throwOnCopy = false;
+
+}
+
+TEST(Result, ThrowingAssignmentKeepsTheOldAlternative) {
+    {
+        Result<FragileCopy> ok = Result<FragileCopy>::ok(FragileCopy());
+        Result<FragileCopy> failed = make_result_failed<FragileCopy>("component", "message");
+        ASSERT_EQ(FragileCopy::live, 1);
+        ASSERT_FALSE(failed.isOK());
+        FragileCopy::throwOnCopy = true;
+        EXPECT_THROW(failed = ok, std::runtime_error);
+        FragileCopy::throwOnCopy = false;
+        ASSERT_FALSE(failed.isOK());
+        assertThat(failed.getException().component(), is(std::string("component")));
+        ASSERT_EQ(FragileCopy::live, 1);
+        failed = ok;
+        ASSERT_TRUE(failed.isOK());
+        ASSERT_EQ(FragileCopy::live, 2);
+    }
+    ASSERT_EQ(FragileCopy::live, 0);
+}
+
+TEST(Result, MapAndFlatmap) {
+    Result<int> r = Result<int>::ok(2);
+    assertThat(r.map([](int x) { return x * 2; }), isResultWhereValue(is(4)));
+    assertThat(r.flatmap([](int x) { return Result<std::string>::ok(std::to_string(x)); }),
+               isResultWhereValue(is(std::string("2"))));
+    assertThat(make_result_failed<int>("c", "m").map([](int x) { return x; }), isFailedResult());
+}
+
+TEST(Result, RvalueMapMovesTheValue) {
+    Result<std::unique_ptr<int>> r = Result<std::unique_ptr<int>>::ok(std::unique_ptr<int>(new int(5)));
+    Result<int> m = std::move(r).map([](std::unique_ptr<int> && p) { return *p; });
+    assertThat(m, isResultWhereValue(is(5)));
+}
+
+TEST(Result, OrElseRecovers) {
+    Result<int> r = make_result_failed<int>("c", "m").or_else([](const ResultException &) {
+        return Result<int>::ok(9);
+    });
+    assertThat(r, isResultWhereValue(is(9)));
+}
+
+TEST(Result, TakeValue) {
+    Result<std::string> r = Result<std::string>::ok("abc");
+    assertThat(r, isValidResult());
+    assertThat(r.takeValue(), is(std::string("abc")));
+    Result<int> i = Result<int>::ok(4);
+    assertThat(i, isValidResult());
+    assertThat(*i.takeValuePtr(), is(4));
+}
+
+TEST(Result, VoidResult) {
+    assertThat(Result<void>::ok().map([] { return 1; }), isResultWhereValue(is(1)));
+    bool called = false;
+    Result<void>::failed(ResultException()).on_failure([&](const ResultException &) { called = true; });
+    assertThat(called, is(true));
+
+    Result<void> failed = Result<void>::failed(ResultException("component", "message"));
+    ASSERT_FALSE(failed.isOK());
+    ResultException taken = failed.takeException();
+    assertThat(taken.component(), is(std::string("component")));
+    ASSERT_FALSE(failed.isOK());
+}
+
+TEST(Result, CustomErrorTypeConvertsAcrossFlatmap) {
+    Result<int, ParseErrc> r = make_result_failed<int, ParseErrc>(ParseErrc::bad_digit);
+    Result<int> converted = Result<int>::translateError(r);
+    assertThat(converted, isFailedResult());
+    assertThat(std::string(converted.getException().mesg()), is(std::string("bad digit")));
+    Result<int, std::errc> mapped = r.mapError([](ParseErrc) { return std::errc::invalid_argument; });
+    assertThat(mapped.getException() == std::errc::invalid_argument, is(true));
+}
+
+TEST(Result, ContextChain) {
+    Result<int> r = make_result_failed<int>("db", "refused")
+        .with_context("repo", "loading user")
+        .with_context("svc", "handling request");
+    assertThat(r, isFailedResult());
+    assertThat(r.getException().context().size(), is(2u));
+    std::ostringstream ss;
+    ss << r.getException();
+    assertThat(ss.str(), is(std::string("db: refused\n  in repo: loading user\n  in svc: handling request")));
+}
+
+TEST(Result, ContextOnSharedErrorLeavesTheOriginal) {
+    Result<int> original = make_result_failed<int>("db", "refused");
+    Result<int> shared = original;
+    Result<int> extended = shared.with_context("repo", "loading user");
+    assertThat(original, isFailedResult());
+    assertThat(extended, isFailedResult());
+    assertThat(original.getException().context().size(), is(0u));
+    assertThat(extended.getException().context().size(), is(1u));
+}
+
+TEST(Result, ContextOverflowsTheInlineFrames) {
+    Result<int> r = make_result_failed<int>("db", "refused");
+    for(int i = 0; i < 10; ++i)
+        r.add_context("layer", "frame");
+    assertThat(r, isFailedResult());
+    assertThat(r.getException().context().size(), is(10u));
+    assertThat(std::string(r.getException().mesg()), is(std::string("refused")));
+}
+
+#if CXXUTILS_RESULT_TRACKING
+namespace {
+
+std::vector<std::string> reports;
+
+void recordReport(const char * what) {
+    reports.push_back(what);
+}
+
+struct TrackingReports : ::testing::Test {
+    TrackingReports() {
+        reports.clear();
+        previous = ResultChecks::setHandler(&recordReport);
+    }
+    ~TrackingReports() {
+        ResultChecks::setHandler(previous);
+    }
+    ResultChecks::Handler previous;
+};
+
+}
+
+TEST_F(TrackingReports, UncheckedAccess) {
+    Result<std::string> r = Result<std::string>::ok("value");
+    r.getValue();
+    assertThat(reports.size(), is(1u));
+    assertThat(reports[0], is(std::string("Result accessed without checking isOK()")));
+}
+
+TEST_F(TrackingReports, CheckedAccessIsQuiet) {
+    Result<std::string> r = Result<std::string>::ok("value");
+    if(r.isOK())
+        r.getValue();
+    Result<int> f = make_result_failed<int>("c", "m");
+    f.map([](int x) { return x; }).on_failure([](const ResultException &) {});
+    assertThat(reports.size(), is(0u));
+}
+
+TEST_F(TrackingReports, DroppedFailure) {
+    {
+        Result<int> r = make_result_failed<int>("c", "m");
+    }
+    {
+        Result<void> v = Result<void>::failed(ResultException());
+    }
+    assertThat(reports.size(), is(2u));
+    assertThat(reports[0], is(std::string("failed Result dropped without being checked")));
+}
+
+TEST_F(TrackingReports, OverwrittenFailure) {
+    Result<int> r = make_result_failed<int>("c", "m");
+    r = Result<int>::ok(1);
+    assertThat(reports.size(), is(1u));
+    assertThat(r, isValidResult());
+}
+
+TEST_F(TrackingReports, MovedAndCopiedFromAreNotReported) {
+    Result<int> a = make_result_failed<int>("c", "m");
+    Result<int> b = std::move(a);
+    Result<int> c = b;
+    assertThat(c, isFailedResult());
+    assertThat(reports.size(), is(0u));
+}
+
+TEST_F(TrackingReports, TrivialResultsAreNotTracked) {
+    {
+        Result<int, std::errc> r = Result<int, std::errc>::failed(std::errc::invalid_argument);
+        (void)r;
+    }
+    assertThat(reports.size(), is(0u));
+}
+#endif
@@ -0,0 +1,115 @@
+#include "cxxutils/result_validated.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <string>
+#include <utility>
+
+using ResultUtils::Validated;
+
+namespace {
+
+struct Order {
+    std::string id;
+    int quantity;
+};
+
+Result<std::string> parse_id(const std::string & s) {
+    if(s.empty())
+        return make_result_failed<std::string>("order", "missing id");
+    return Result<std::string>::ok(s);
+}
+
+Result<int> parse_quantity(int q) {
+    if(q <= 0)
+        return make_result_failed<int>("order", "quantity must be positive");
+    return Result<int>::ok(q);
+}
+
+Result<void> not_empty(const std::string & s) {
+    if(s.empty())
+        return make_result_failed<void>("name", "empty");
+    return Result<void>::ok();
+}
+
+Result<void> short_enough(const std::string & s) {
+    if(s.size() > 8)
+        return make_result_failed<void>("name", "too long");
+    return Result<void>::ok();
+}
+
+Result<void> lower_case(const std::string & s) {
+    for(char c : s) {
+        if(c < 'a' || c > 'z')
+            return make_result_failed<void>("name", "not lower case");
+    }
+    return Result<void>::ok();
+}
+
+Order make_order(std::string id, int quantity) {
+    return Order{std::move(id), quantity};
+}
+
+}
+
+TEST(Validated, CombineBuildsTheValue) {
+    Validated<Order> order = ResultUtils::combine(make_order, parse_id("A1"), parse_quantity(3));
+    assertThat(order.isValid(), is(true));
+    assertThat(order.getValue().id, is(std::string("A1")));
+    assertThat(order.getValue().quantity, is(3));
+}
+
+TEST(Validated, CombineKeepsEveryError) {
+    Validated<Order> order = ResultUtils::combine(make_order, parse_id(""), parse_quantity(0));
+    assertThat(order.isValid(), is(false));
+    assertThat(static_cast<int>(order.errors().size()), is(2));
+    assertThat(std::string(order.errors()[0].mesg()), is(std::string("missing id")));
+    assertThat(std::string(order.errors()[1].mesg()), is(std::string("quantity must be positive")));
+    assertThat(order.errors().isInline(), is(true));
+}
+
+TEST(Validated, CombineMixesValidatedAndResult) {
+    Validated<int> quantity = Validated<int>::invalid(ResultException("order", "bad quantity"));
+    Validated<Order> order = ResultUtils::combine(make_order, parse_id(""), std::move(quantity));
+    assertThat(static_cast<int>(order.errors().size()), is(2));
+}
+
+TEST(Validated, ValidateRunsEveryCheck) {
+    Validated<std::string> ok = ResultUtils::validate(std::string("alice"), not_empty, short_enough, lower_case);
+    assertThat(ok.isValid(), is(true));
+    assertThat(ok.getValue(), is(std::string("alice")));
+
+    Validated<std::string> bad = ResultUtils::validate(std::string("Bartholomew"), not_empty, short_enough, lower_case);
+    assertThat(static_cast<int>(bad.errors().size()), is(2));
+    assertThat(std::string(bad.errors()[0].mesg()), is(std::string("too long")));
+    assertThat(std::string(bad.errors()[1].mesg()), is(std::string("not lower case")));
+}
+
+TEST(Validated, SpillsPastTheInlineErrors) {
+    auto fail = [](int) { return make_result_failed<void>("c", "e"); };
+    Validated<int, ResultException, 2> two = Validated<int, ResultException, 2>::invalid(ResultException("c", "e"));
+    assertThat(two.errors().isInline(), is(true));
+    Validated<int> five = ResultUtils::validate(1, fail, fail, fail, fail, fail);
+    assertThat(static_cast<int>(five.errors().size()), is(5));
+    assertThat(five.errors().isInline(), is(false));
+}
+
+TEST(Validated, ToResult) {
+    assertThat(Validated<int>::valid(4).toResult(), isResultWhereValue(is(4)));
+
+    Validated<int> one(make_result_failed<int>("c", "m"));
+    Result<int> single = one.toResult();
+    assertThat(single, isFailedResult());
+    assertThat(std::string(single.getException().mesg()), is(std::string("m")));
+
+    Validated<Order> order = ResultUtils::combine(make_order, parse_id(""), parse_quantity(0));
+    Result<Order> combined = std::move(order).toResult();
+    assertThat(combined, isFailedResult());
+    assertThat(std::string(combined.getException().mesg()),
+               is(std::string("2 failures; order: missing id; order: quantity must be positive")));
+}
+
+TEST(Validated, FromResult) {
+    Validated<int> v = Result<int>::ok(2);
+    assertThat(v.isValid(), is(true));
+    assertThat(v.takeValue(), is(2));
+}
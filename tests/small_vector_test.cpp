@@ -0,0 +1,58 @@
+#include "cxxutils/small_vector.hpp"
+#include "cxxutils/test/testutils.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+using cxxutils::SmallVector;
+
+TEST(SmallVector, StaysInlineUpToN) {
+    SmallVector<std::string, 2> v;
+    assertThat(v.empty(), is(true));
+    v.push_back("a");
+    v.emplace_back("b");
+    assertThat(v.isInline(), is(true));
+    assertThat(static_cast<int>(v.capacity()), is(2));
+    v.push_back("c");
+    assertThat(v.isInline(), is(false));
+    assertThat(static_cast<int>(v.size()), is(3));
+    assertThat(v[0], is(std::string("a")));
+    assertThat(v.back(), is(std::string("c")));
+}
+
+TEST(SmallVector, PushingAnElementOfItselfWhileGrowing) {
+    SmallVector<std::string, 1> v;
+    v.push_back("only");
+    v.push_back(v.front());
+    assertThat(v[1], is(std::string("only")));
+}
+
+TEST(SmallVector, CopyAndMove) {
+    SmallVector<std::string, 2> inlined{"a", "b"};
+    SmallVector<std::string, 2> spilled{"a", "b", "c"};
+    SmallVector<std::string, 2> copy(spilled);
+    assertThat(static_cast<int>(copy.size()), is(3));
+    SmallVector<std::string, 2> moved(std::move(spilled));
+    assertThat(static_cast<int>(moved.size()), is(3));
+    assertThat(spilled.empty(), is(true));
+    assertThat(spilled.isInline(), is(true));
+    moved = std::move(inlined);
+    assertThat(static_cast<int>(moved.size()), is(2));
+    assertThat(moved.isInline(), is(true));
+    assertThat(moved[1], is(std::string("b")));
+    copy = moved;
+    assertThat(static_cast<int>(copy.size()), is(2));
+}
+
+TEST(SmallVector, MoveOnlyElements) {
+    SmallVector<std::unique_ptr<int>, 1> v;
+    v.push_back(std::unique_ptr<int>(new int(1)));
+    v.push_back(std::unique_ptr<int>(new int(2)));
+    SmallVector<std::unique_ptr<int>, 4> other;
+    other.append(std::move(v));
+    assertThat(static_cast<int>(other.size()), is(2));
+    assertThat(*other[1], is(2));
+    other.pop_back();
+    assertThat(static_cast<int>(other.size()), is(1));
+}